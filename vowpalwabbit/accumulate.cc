@@ -76,22 +76,25 @@ void accumulate_weighted_avg(vw& all, string master_location, regressor& reg) {
   uint32_t length = 1 << all.num_bits; //This is the number of parameters
   size_t stride = 1 << all.reg.stride_shift;
   weight* weights = reg.weight_vector;
+  // the adaptive and normalized sums follow each weight unless --split_weights keeps them apart
+  weight* state = reg.state_vector != nullptr ? reg.state_vector : weights;
+  size_t state_stride = reg.state_vector != nullptr ? reg.state_stride : stride;
   float* local_weights = new float[length];
 
   for(uint32_t i = 0;i < length;i++) 
-    local_weights[i] = weights[stride*i+1];
+    local_weights[i] = state[state_stride*i+1];
   
   //First compute weights for averaging
   all_reduce<float, add_float>(local_weights, length, master_location, all.unique_id, all.total, all.node, all.socks);
   
   for(uint32_t i = 0;i < length;i++) //Compute weighted versions
     if(local_weights[i] > 0) {
-      float ratio = weights[stride*i+1]/local_weights[i];
+      float ratio = state[state_stride*i+1]/local_weights[i];
       local_weights[i] = weights[stride*i] * ratio;      
       weights[stride*i] *= ratio;
-      weights[stride*i+1] *= ratio; //A crude max      
+      state[state_stride*i+1] *= ratio; //A crude max      
       if (all.normalized_updates)	
-	weights[stride*i+all.normalized_idx] *= ratio; //A crude max
+	state[state_stride*i+all.normalized_idx] *= ratio; //A crude max
     }
     else {
       local_weights[i] = 0;
@@ -99,6 +102,8 @@ void accumulate_weighted_avg(vw& all, string master_location, regressor& reg) {
     }
   
   all_reduce<float, add_float>(weights, length*stride, master_location, all.unique_id, all.total, all.node, all.socks);
+  if (reg.state_vector != nullptr)
+    all_reduce<float, add_float>(state, length*state_stride+1, master_location, all.unique_id, all.total, all.node, all.socks);
   
   delete[] local_weights;
 }
@@ -0,0 +1,84 @@
+/*
+Copyright (c) by respective owners including Yahoo!, Microsoft, and
+individual contributors. All rights reserved.  Released under a BSD
+license as described in the file LICENSE.
+ */
+#pragma once
+#include <string.h>
+#include "memory.h"
+#include "v_array.h"
+
+// Bump allocator for the audit strings of an example.  The parser carves
+// its namespace and feature names out of the example's arena instead of
+// allocating each one, and empty_example hands the whole arena back at once.
+// Blocks are kept across resets, so once the ring has warmed up parsing
+// with --audit or --invert_hash no longer calls the allocator.
+struct arena_block {
+  arena_block* next;
+  size_t size;
+};
+
+const size_t arena_block_size = 8192;
+
+struct arena {
+  arena_block* first;
+  arena_block* current; // nullptr until the first allocation after a reset
+  char* head;
+  char* limit;
+};
+
+inline void next_arena_block(arena& a, size_t bytes)
+{
+  arena_block* b = a.current == nullptr ? a.first : a.current->next;
+  if (b == nullptr || b->size < bytes)
+    {
+      size_t size = max(arena_block_size, bytes);
+      arena_block* fresh = (arena_block*)calloc_or_die<char>(sizeof(arena_block) + size);
+      fresh->size = size;
+      fresh->next = b;
+      if (a.current == nullptr)
+        a.first = fresh;
+      else
+        a.current->next = fresh;
+      b = fresh;
+    }
+  a.current = b;
+  a.head = (char*)(b + 1);
+  a.limit = a.head + b->size;
+}
+
+inline char* arena_alloc(arena& a, size_t bytes)
+{
+  if ((size_t)(a.limit - a.head) < bytes)
+    next_arena_block(a, bytes);
+  char* ret = a.head;
+  a.head += bytes;
+  return ret;
+}
+
+// a nul terminated copy of [begin, begin+length)
+inline char* arena_copy(arena& a, const char* begin, size_t length)
+{
+  char* ret = arena_alloc(a, length + 1);
+  memcpy(ret, begin, length);
+  ret[length] = '\0';
+  return ret;
+}
+
+inline void reset_arena(arena& a)
+{
+  a.current = nullptr;
+  a.head = a.limit = nullptr;
+}
+
+inline void free_arena(arena& a)
+{
+  for (arena_block* b = a.first; b != nullptr;)
+    {
+      arena_block* next = b->next;
+      free(b);
+      b = next;
+    }
+  a.first = a.current = nullptr;
+  a.head = a.limit = nullptr;
+}
@@ -19,6 +19,7 @@ Implementation by Miro Dudik.
 #include <sys/timeb.h>
 #include "accumulate.h"
 #include "gd.h"
+#include "chunked_model.h"
 
 using namespace std;
 using namespace LEARNER;
@@ -799,14 +800,18 @@ void end_pass(bfgs& b)
                set_done(*all);
                cerr<<"Early termination reached w.r.t. holdout set error";
              }
-	   } if (b.final_pass == b.current_pass) {
+	   } if (b.final_pass == b.current_pass && !b.output_regularizer) {
 	     finalize_regressor(*all, all->final_regressor_name); 
 	     set_done(*all);
 	   }
            
        }else{//reaching convergence in the previous pass
         if(b.output_regularizer) 
+          { // the preconditioner pass is done, the regularizer can be saved
            preconditioner_to_regularizer(*all, b, (*all).l2_lambda);
+           finalize_regressor(*all, all->final_regressor_name);
+           set_done(*all);
+          }
         b.current_pass ++;
       }   
                 
@@ -842,8 +847,31 @@ void finish(bfgs& b)
   free(b.alpha);
 }
 
+static bool get_regularizer_row(void* data, uint64_t i, weight* row)
+{
+  bfgs& b = *(bfgs*)data;
+  row[0] = b.regularizers[2*i];
+  row[1] = b.regularizers[2*i+1];
+  return row[0] != 0. || row[1] != 0.;
+}
+
+static void set_regularizer_row(void* data, uint64_t i, const weight* row, uint32_t stride)
+{
+  bfgs& b = *(bfgs*)data;
+  for (size_t k = 0; k < min(stride, (uint32_t)2); k++)
+    b.regularizers[2*i+k] = row[k];
+  if (stride > 1) // BFGS starts from the prior mean
+    b.all->reg.weight_vector[i << b.all->reg.stride_shift] = row[1];
+}
+
 void save_load_regularizer(vw& all, bfgs& b, io_buf& model_file, bool read, bool text)
 {
+  if ((read ? all.loaded_layout == WEIGHTS_CHUNKED : all.chunked_model) && !text)
+    { // the regularizer and the prior mean of each weight as a row
+      chunked_rows r = {all.length(), 2, &b, get_regularizer_row, set_regularizer_row, false};
+      save_load_chunked(all, model_file, read, r);
+      return;
+    }
 
   char buff[512];
   int c = 0;
@@ -865,6 +893,8 @@ void save_load_regularizer(vw& all, bfgs& b, io_buf& model_file, bool read, bool
 	      v = &(b.regularizers[i]);
 	      if (brw > 0)
 		brw += bin_read_fixed(model_file, (char*)v, sizeof(*v), "");
+	      if (i%2 == 1) // This is the prior mean
+		all.reg.weight_vector[(i/2*stride)] = *v;
 	    }
 	}
       else // write binary or text
@@ -880,8 +910,6 @@ void save_load_regularizer(vw& all, bfgs& b, io_buf& model_file, bool read, bool
 	      text_len = sprintf(buff, ":%f\n", *v);
 	      brw+= bin_text_write_fixed(model_file,(char *)v, sizeof (*v),
 					 buff, text_len, text);
-	      if (read && i%2 == 1) // This is the prior mean
-		all.reg.weight_vector[(i/2*stride)] = *v;
 	    }
 	}
       if (!read)
@@ -6,20 +6,110 @@ license as described in the file LICENSE.
 #include "cache.h"
 #include "unique_sort.h"
 #include "global_data.h"
+#include "parser.h"
+
+// the ssse3 decoder writes features as pairs of x and a 32 bit index
+#if !defined(VW_NO_INLINE_SIMD) && !defined(VW_64BIT_INDICES) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define VW_VBYTE_SSSE3
+#endif
 
 const size_t neg_1 = 1;
 const size_t general = 2;
+const uint32_t wide_block = 0x80000000; // set in the count of a namespace stored as varints
 
-char* run_len_decode(char *p, uint32_t& i)
+char* run_len_decode(char *p, size_t& i)
 {// read an int 7 bits at a time.
   size_t count = 0;
   while(*p & 128)\
-    i = i | ((*(p++) & 127) << 7*count++);
-  i = i | (*(p++) << 7*count);
+    i = i | ((size_t)(*(p++) & 127) << 7*count++);
+  i = i | ((size_t)(unsigned char)*(p++) << 7*count);
   return p;
 }
 
 inline int32_t ZigZagDecode(uint32_t n) { return (n >> 1) ^ -static_cast<int32_t>(n & 1); }
+inline int64_t ZigZagDecode64(uint64_t n) { return (int64_t)(n >> 1) ^ -static_cast<int64_t>(n & 1); }
+
+// The features of a namespace are stored in stream-vbyte layout: their
+// count, one control byte per four values, the values, and then the floats
+// of the features whose value isn't 1 or -1.  Every value is the zigzag
+// coded index delta shifted left by two, or'ed with the neg_1/general flags,
+// and takes 1 to 4 bytes as given by its 2 bits in the control byte.  The
+// last group of four is padded with 1 byte zeros, so each control byte
+// describes exactly four values and the decoder never needs a count check.
+// A namespace with a delta too wide for 30 bits, as the indices of a -b
+// over 29 can have, has wide_block set in its count and its values stored
+// as 7 bit varints of 64 bit deltas instead of the control bytes.
+struct vbyte_tables {
+  unsigned char length[256]; // data bytes described by a control byte
+  unsigned char shuffle[256][16]; // pshufb masks spreading them into 4 ints
+  bool ssse3; // whether this cpu has pshufb
+
+  vbyte_tables() {
+    for (size_t control = 0; control < 256; control++)
+      {
+	size_t at = 0;
+	for (size_t j = 0; j < 4; j++)
+	  {
+	    size_t len = ((control >> (2*j)) & 3) + 1;
+	    for (size_t b = 0; b < 4; b++)
+	      shuffle[control][4*j + b] = b < len ? (unsigned char)(at + b) : 0x80;
+	    at += len;
+	  }
+	length[control] = (unsigned char)at;
+      }
+#ifdef VW_VBYTE_SSSE3
+    __builtin_cpu_init();
+    ssse3 = __builtin_cpu_supports("ssse3") != 0;
+#else
+    ssse3 = false;
+#endif
+  }
+};
+
+static vbyte_tables vbyte;
+
+// Both decoders turn groups of four values into features holding the index
+// and, in place of x, the value (for its flags); read_cached_example fixes
+// up x afterwards.  They write whole groups, so out needs room for 4*groups.
+char* vbyte_decode(unsigned char* control, size_t groups, char* data, feature_index last, feature* out)
+{
+  for (size_t g = 0; g < groups; g++)
+    for (size_t j = 0; j < 4; j++, out++)
+      {
+	size_t len = ((control[g] >> (2*j)) & 3) + 1;
+	uint32_t value = 0;
+	memcpy(&value, data, len);
+	data += len;
+	last += ZigZagDecode(value >> 2);
+	memcpy(&out->x, &value, sizeof(value));
+	out->weight_index = last;
+      }
+  return data;
+}
+
+#ifdef VW_VBYTE_SSSE3
+// end is where the readable bytes stop: pshufb loads 16 bytes at a time.
+__attribute__((target("ssse3")))
+char* vbyte_decode_ssse3(unsigned char* control, size_t groups, char* data, char* end, uint32_t last, feature* out)
+{
+  size_t g = 0;
+  for (; g < groups && data + 16 <= end; g++, out += 4)
+    {
+      __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((__m128i*)data), _mm_loadu_si128((__m128i*)vbyte.shuffle[control[g]]));
+      __m128i z = _mm_srli_epi32(v, 2);
+      __m128i d = _mm_xor_si128(_mm_srli_epi32(z, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(z, _mm_set1_epi32(1))));
+      d = _mm_add_epi32(d, _mm_slli_si128(d, 4)); // prefix sum of the deltas
+      d = _mm_add_epi32(d, _mm_slli_si128(d, 8));
+      d = _mm_add_epi32(d, _mm_set1_epi32((int)last));
+      _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi32(v, d));
+      _mm_storeu_si128((__m128i*)(out + 2), _mm_unpackhi_epi32(v, d));
+      last = (uint32_t)_mm_cvtsi128_si32(_mm_shuffle_epi32(d, 0xff));
+      data += vbyte.length[control[g]];
+    }
+  return vbyte_decode(control + g, groups - g, data, last, out);
+}
+#endif
 
 size_t read_cached_tag(io_buf& cache, example* ae)
 {
@@ -33,7 +123,7 @@ size_t read_cached_tag(io_buf& cache, example* ae)
   if (buf_read(cache, c, tag_size) < tag_size) 
     return 0;
   
-  ae->tag.erase();
+  ae->tag.clear();
   push_many(ae->tag, c, tag_size);
   return tag_size+sizeof(tag_size);
 }
@@ -44,14 +134,12 @@ __attribute__((packed))
 #endif
 	;
 
-int read_cached_features(void* in, example* ec)
+int read_cached_example(vw& all, io_buf& in, example* ae)
 {
-  vw* all = (vw*)in;
-  example* ae = (example*)ec;
-  ae->sorted = all->p->sorted_cache;
-  io_buf* input = all->p->input;
+  ae->sorted = all.p->sorted_cache;
+  io_buf* input = &in;
 
-  size_t total = all->p->lp.read_cached_label(all->sd, &ae->l, *input);
+  size_t total = all.p->lp.read_cached_label(all.sd, &ae->l, *input);
   if (total == 0)
     return 0;
   if (read_cached_tag(*input,ae) == 0)
@@ -63,7 +151,7 @@ int read_cached_features(void* in, example* ec)
   num_indices = *(unsigned char*)c;
   c += sizeof(num_indices);
 
-  all->p->input->set(c);
+  input->set(c);
   for (;num_indices > 0; num_indices--)
     {
       size_t temp;
@@ -76,11 +164,11 @@ int read_cached_features(void* in, example* ec)
       index = *(unsigned char*)c;
       c+= sizeof(index);
       ae->indices.push_back((size_t)index);
-      v_array<feature>* ours = ae->atomics+index;
-      float* our_sum_feat_sq = ae->sum_feat_sq+index;
+      v_array<feature>* ours = &ae->atomics[index];
+      float* our_sum_feat_sq = &ae->sum_feat_sq[index];
       size_t storage = *(size_t *)c;
       c += sizeof(size_t);
-      all->p->input->set(c);
+      input->set(c);
       total += storage; 
      if (buf_read(*input,c,storage) < storage) {
 	cerr << "truncated example! wanted: " << storage << " bytes" << endl;
@@ -89,34 +177,162 @@ int read_cached_features(void* in, example* ec)
 
       char *end = c+storage;
 
-      uint32_t last = 0;
-      
-      for (;c!= end;)
-	{	  
-	  feature f = {1., 0};
-	  c = run_len_decode(c,f.weight_index);
-	  if (f.weight_index & neg_1) 
-	    f.x = -1.;
-	  else if (f.weight_index & general)	    {
-	      f.x = ((one_float *)c)->f;
-	      c += sizeof(float);
+      uint32_t count;
+      memcpy(&count, c, sizeof(count));
+      bool wide = (count & wide_block) != 0;
+      count &= ~wide_block;
+      unsigned char* control = (unsigned char*)c + sizeof(count);
+      size_t groups = (count + 3) / 4;
+
+      if ((size_t)(ours->end_array - ours->end) < 4 * groups)
+	ours->resize(ours->size() + 4 * groups);
+      feature* first = ours->end;
+
+      char* floats;
+      if (wide)
+	{
+	  floats = (char*)control;
+	  feature_index index = 0;
+	  for (feature* f = first; f != first + count; f++)
+	    {
+	      size_t value = 0;
+	      floats = run_len_decode(floats, value);
+	      index += (feature_index)ZigZagDecode64(value >> 2);
+	      uint32_t flags = (uint32_t)(value & 3);
+	      memcpy(&f->x, &flags, sizeof(flags));
+	      f->weight_index = index;
 	    }
-	  *our_sum_feat_sq += f.x*f.x;
-          uint32_t diff = f.weight_index >> 2;
+	}
+      else
+	{
+	  char* data = (char*)control + groups;
+	  floats = data;
+	  for (size_t g = 0; g < groups; g++)
+	    floats += vbyte.length[control[g]];
+#ifdef VW_VBYTE_SSSE3
+	  if (vbyte.ssse3)
+	    vbyte_decode_ssse3(control, groups, data, end, 0, first);
+	  else
+#endif
+	    vbyte_decode(control, groups, data, 0, first);
+	}
+      ours->end = first + count;
 
-          int32_t s_diff = ZigZagDecode(diff);
-	  if (s_diff < 0)
+      feature_index last = 0;
+      for (feature* f = first; f != ours->end; f++)
+	{
+	  uint32_t value;
+	  memcpy(&value, &f->x, sizeof(value));
+	  if (value & neg_1) 
+	    f->x = -1.;
+	  else if (value & general)
+	    {
+	      f->x = ((one_float *)floats)->f;
+	      floats += sizeof(float);
+	    }
+	  else
+	    f->x = 1.;
+	  *our_sum_feat_sq += f->x*f->x;
+	  if (f->weight_index < last)
 	    ae->sorted = false;
-	  f.weight_index = last + s_diff;
-	  last = f.weight_index;
-	  ours->push_back(f);
+	  last = f->weight_index;
 	}
-      all->p->input->set(c);
+      c = end;
+      input->set(c);
     }
 
   return (int)total;
 }
 
+int read_cached_features(void* in, example* ec)
+{
+  vw* all = (vw*)in;
+  return read_cached_example(*all, *all->p->input, ec);
+}
+
+// returns where the header was in the input, nullptr if the input ended
+char* read_cache_block_header(io_buf& input, uint64_t& bytes, uint32_t& examples)
+{
+  char* c;
+  if (buf_read(input, c, cache_block_header_size) < cache_block_header_size)
+    return nullptr;
+  memcpy(&bytes, c, sizeof(bytes));
+  memcpy(&examples, c + sizeof(bytes), sizeof(examples));
+  return c;
+}
+
+int read_cached_block_features(void* in, example* ec)
+{
+  vw* all = (vw*)in;
+  parser* p = all->p;
+  if (p->cache_block_left == 0)
+    {
+      uint64_t bytes;
+      uint32_t examples;
+      if (read_cache_block_header(*p->input, bytes, examples) == nullptr || examples == 0)
+	return 0;
+      p->cache_block_left = examples;
+    }
+  p->cache_block_left--;
+  return read_cached_features(in, ec);
+}
+
+void bad_cache_index()
+{
+  cerr << "error: --cache_skip needs an uncompressed cache with a block index; make a new one with -k" << endl;
+  throw exception();
+}
+
+// Moves the cache open as f past its first skip examples, for a run picking up
+// partway through it (--cache_skip).  The index at the end of the cache gives
+// the block to start in; the examples to skip in that block are decoded and
+// dropped.
+void seek_cache(vw& all, int f, size_t skip)
+{
+  parser* p = all.p;
+  io_buf& input = *p->input;
+  const size_t entry_size = sizeof(uint64_t) + sizeof(uint32_t);
+  uint64_t trailer[2]; // the index offset and the number of blocks
+  int64_t end = input.seek_file(f, 0, SEEK_END);
+  if (end < (int64_t)sizeof(trailer) || input.seek_file(f, end - sizeof(trailer), SEEK_SET) < 0
+      || input.read_file(f, trailer, sizeof(trailer)) < (ssize_t)sizeof(trailer)
+      || trailer[0] + trailer[1] * entry_size + sizeof(trailer) != (uint64_t)end)
+    bad_cache_index();
+
+  // read the index a chunk at a time until the block holding example skip
+  char entries[4096 * entry_size];
+  size_t first = 0; // examples before the current block
+  cache_index_entry block = {0, 0};
+  input.seek_file(f, trailer[0], SEEK_SET);
+  for (uint64_t b = 0; b < trailer[1] && first + block.examples <= skip; )
+    {
+      size_t n = (size_t)min(trailer[1] - b, (uint64_t)4096);
+      if (input.read_file(f, entries, n * entry_size) < (ssize_t)(n * entry_size))
+	bad_cache_index();
+      for (char* e = entries; e != entries + n * entry_size && first + block.examples <= skip; e += entry_size, b++)
+	{
+	  first += block.examples;
+	  memcpy(&block.offset, e, sizeof(block.offset));
+	  memcpy(&block.examples, e + sizeof(block.offset), sizeof(block.examples));
+	}
+    }
+  if (first + block.examples <= skip)
+    {
+      cerr << "error: --cache_skip " << skip << " is past the " << first + block.examples << " examples in the cache" << endl;
+      throw exception();
+    }
+
+  input.seek_file(f, block.offset, SEEK_SET);
+  example* ec = alloc_examples(p->lp.label_size, 1);
+  p->lp.default_label(&ec->l);
+  for (; first < skip; first++)
+    if (read_cached_block_features(&all, ec) == 0)
+      bad_cache_index();
+  dealloc_example(p->lp.delete_label, *ec);
+  free(ec);
+  p->in_pass_counter = skip; // so the same examples are held out
+}
+
 char* run_len_encode(char *p, size_t i)
 {// store an int 7 bits at a time.
   while (i >= 128)
@@ -133,6 +349,8 @@ inline uint32_t ZigZagEncode(int32_t n) {
   return ret;
 }
 
+inline uint64_t ZigZagEncode64(int64_t n) { return ((uint64_t)n << 1) ^ (uint64_t)(n >> 63); }
+
 void output_byte(io_buf& cache, unsigned char s)
 {
   char *c;
@@ -142,10 +360,24 @@ void output_byte(io_buf& cache, unsigned char s)
   cache.set(c);
 }
 
-void output_features(io_buf& cache, unsigned char index, feature* begin, feature* end, uint32_t mask)
+inline size_t vbyte_code(uint32_t v)
+{ return v < (1 << 8) ? 0 : v < (1 << 16) ? 1 : v < (1 << 24) ? 2 : 3; }
+
+void output_features(io_buf& cache, unsigned char index, feature* begin, feature* end, size_t mask)
 {
   char* c;
-  size_t storage = (end-begin) * int_size;
+  uint32_t count = (uint32_t)(end - begin);
+  size_t groups = (count + 3) / 4;
+  bool wide = false;
+  feature_index previous = 0;
+  for (feature* i = begin; i != end; i++)
+    {
+      feature_index cache_index = i->weight_index & mask;
+      if (ZigZagEncode64((int64_t)cache_index - (int64_t)previous) >= (1 << 30))
+	wide = true;
+      previous = cache_index;
+    }
+  size_t storage = sizeof(count) + (wide ? 10 * count : groups + 4 * sizeof(uint32_t) * groups);
   for (feature* i = begin; i != end; i++)
     if (i->x != 1. && i->x != -1.)
       storage += sizeof(float);
@@ -156,24 +388,60 @@ void output_features(io_buf& cache, unsigned char index, feature* begin, feature
   char *storage_size_loc = c;
   c += sizeof(size_t);
 
-  uint32_t last = 0;
-  
-  for (feature* i = begin; i != end; i++)
+  uint32_t flagged_count = wide ? count | wide_block : count;
+  memcpy(c, &flagged_count, sizeof(flagged_count));
+  c += sizeof(count);
+
+  if (wide)
     {
-      uint32_t cache_index = (i->weight_index) & mask;
-      int32_t s_diff = (cache_index - last);
-      size_t diff = ZigZagEncode(s_diff) << 2;
-      last = cache_index;
-      if (i->x == 1.) 
-	c = run_len_encode(c, diff);
-      else if (i->x == -1.) 
-	c = run_len_encode(c, diff | neg_1);
-      else {
-	c = run_len_encode(c, diff | general);
+      feature_index last = 0;
+      for (feature* i = begin; i != end; i++)
+	{
+	  feature_index cache_index = i->weight_index & mask;
+	  size_t value = ZigZagEncode64((int64_t)cache_index - (int64_t)last) << 2;
+	  last = cache_index;
+	  if (i->x == -1.)
+	    value |= neg_1;
+	  else if (i->x != 1.)
+	    value |= general;
+	  c = run_len_encode(c, value);
+	}
+    }
+  else
+    {
+      unsigned char* control = (unsigned char*)c;
+      memset(control, 0, groups);
+      c += groups;
+
+      uint32_t last = 0;
+      for (size_t k = 0; k < 4 * groups; k++)
+	{
+	  uint32_t value = 0; // padding
+	  if (k < count)
+	    {
+	      feature* i = begin + k;
+	      uint32_t cache_index = (uint32_t)(i->weight_index & mask);
+	      int32_t s_diff = (cache_index - last);
+	      value = ZigZagEncode(s_diff) << 2;
+	      last = cache_index;
+	      if (i->x == -1.) 
+		value |= neg_1;
+	      else if (i->x != 1.)
+		value |= general;
+	    }
+	  size_t code = vbyte_code(value);
+	  control[k / 4] |= (unsigned char)(code << (2 * (k % 4)));
+	  memcpy(c, &value, code + 1);
+	  c += code + 1;
+	}
+    }
+
+  for (feature* i = begin; i != end; i++)
+    if (i->x != 1. && i->x != -1.)
+      {
 	memcpy(c, &i->x, sizeof(i->x));
 	c += sizeof(i->x);
       }
-    }
   cache.set(c);
   *(size_t*)storage_size_loc = c - storage_size_loc - sizeof(size_t);  
 }
@@ -189,10 +457,191 @@ void cache_tag(io_buf& cache, v_array<char> tag)
   cache.set(c);
 }
 
-void cache_features(io_buf& cache, example* ae, uint32_t mask)
+void cache_features(io_buf& cache, example* ae, size_t mask)
 {
   cache_tag(cache,ae->tag);
   output_byte(cache, (unsigned char) ae->indices.size());
   for (unsigned char* b = ae->indices.begin; b != ae->indices.end; b++)
     output_features(cache, *b, ae->atomics[*b].begin,ae->atomics[*b].end, mask);
 }
+
+void output_cache_block(parser& p)
+{
+  io_buf& block = *p.cache_block;
+  uint64_t bytes = block.space.size();
+  uint32_t examples = (uint32_t)p.cache_block_count;
+  cache_index_entry e = {p.cache_bytes, examples};
+  if (examples > 0)
+    p.cache_index.push_back(e);
+
+  bin_write_fixed(*p.output, (char*)&bytes, sizeof(bytes));
+  bin_write_fixed(*p.output, (char*)&examples, sizeof(examples));
+  if (bytes > 0)
+    bin_write_fixed(*p.output, block.space.begin, (uint32_t)bytes);
+  p.cache_bytes += cache_block_header_size + bytes;
+
+  block.space.end = block.space.begin;
+  p.cache_block_count = 0;
+}
+
+void cache_example(vw& all, example* ae)
+{
+  parser& p = *all.p;
+  p.lp.cache_label(&ae->l, *p.cache_block);
+  cache_features(*p.cache_block, ae, all.parse_mask);
+  if (++p.cache_block_count == cache_block_size)
+    output_cache_block(p);
+}
+
+void finish_cache(parser& p)
+{
+  if (p.cache_block_count > 0)
+    output_cache_block(p);
+  output_cache_block(p); // the empty block ending the examples
+
+  uint64_t index_offset = p.cache_bytes;
+  uint64_t num_blocks = p.cache_index.size();
+  for (cache_index_entry* e = p.cache_index.begin; e != p.cache_index.end; e++)
+    {
+      bin_write_fixed(*p.output, (char*)&e->offset, sizeof(e->offset));
+      bin_write_fixed(*p.output, (char*)&e->examples, sizeof(e->examples));
+    }
+  bin_write_fixed(*p.output, (char*)&index_offset, sizeof(index_offset));
+  bin_write_fixed(*p.output, (char*)&num_blocks, sizeof(num_blocks));
+
+  p.cache_index.delete_v();
+  delete p.cache_block;
+  p.cache_block = nullptr;
+}
+
+// an audit string as its length with the nul (0 for none) and its bytes
+void memory_cache_string(io_buf& cache, const char* s)
+{
+  size_t length = s == nullptr ? 0 : strlen(s) + 1;
+  char* c;
+  buf_write(cache, c, sizeof(length) + length);
+  memcpy(c, &length, sizeof(length));
+  if (length > 0)
+    memcpy(c + sizeof(length), s, length);
+}
+
+bool read_memory_cached_string(io_buf& cache, arena& strings, char*& s)
+{
+  char* c;
+  size_t length;
+  if (buf_read(cache, c, sizeof(length)) < sizeof(length))
+    return false;
+  memcpy(&length, c, sizeof(length));
+  s = nullptr;
+  if (length == 0)
+    return true;
+  if (buf_read(cache, c, length) < length)
+    return false;
+  s = arena_copy(strings, c, length - 1);
+  return true;
+}
+
+void memory_cache_example(vw& all, example* ae)
+{
+  io_buf& cache = *all.p->memory_cache;
+  all.p->lp.cache_label(&ae->l, cache);
+  cache_tag(cache, ae->tag);
+  output_byte(cache, (unsigned char)ae->sorted);
+  output_byte(cache, (unsigned char)ae->indices.size());
+  for (unsigned char* b = ae->indices.begin; b != ae->indices.end; b++)
+    {
+      v_array<feature>& features = ae->atomics[*b];
+      size_t count = features.size();
+      char* c;
+      buf_write(cache, c, sizeof(*b) + sizeof(count) + sizeof(float) + count * sizeof(feature));
+      *c = *b;
+      c += sizeof(*b);
+      memcpy(c, &count, sizeof(count));
+      c += sizeof(count);
+      memcpy(c, &ae->sum_feat_sq[*b], sizeof(float));
+      c += sizeof(float);
+      memcpy(c, features.begin, count * sizeof(feature));
+      c += count * sizeof(feature);
+      cache.set(c);
+
+      if (all.audit || all.hash_inv)
+	{ // the audit features, with copies of their strings
+	  v_array<audit_data>& audit = ae->audit_features[*b];
+	  size_t audit_count = audit.size();
+	  buf_write(cache, c, sizeof(audit_count));
+	  memcpy(c, &audit_count, sizeof(audit_count));
+	  for (audit_data* a = audit.begin; a != audit.end; a++)
+	    {
+	      buf_write(cache, c, sizeof(a->weight_index) + sizeof(a->x));
+	      memcpy(c, &a->weight_index, sizeof(a->weight_index));
+	      memcpy(c + sizeof(a->weight_index), &a->x, sizeof(a->x));
+	      memory_cache_string(cache, a->space);
+	      memory_cache_string(cache, a->feature);
+	    }
+	}
+    }
+}
+
+int read_memory_cached_features(void* in, example* ae)
+{
+  vw* all = (vw*)in;
+  io_buf& cache = *all->p->memory_cache;
+  size_t total = all->p->lp.read_cached_label(all->sd, &ae->l, cache);
+  if (total == 0 || read_cached_tag(cache, ae) == 0)
+    return 0;
+
+  char* c;
+  if (buf_read(cache, c, 2) < 2)
+    return 0;
+  ae->sorted = c[0] != 0;
+  unsigned char num_indices = c[1];
+  for (; num_indices > 0; num_indices--)
+    {
+      const size_t header = sizeof(unsigned char) + sizeof(size_t) + sizeof(float);
+      if (buf_read(cache, c, header) < header)
+	return 0;
+      unsigned char index = *c;
+      size_t count;
+      memcpy(&count, c + sizeof(index), sizeof(count));
+      memcpy(&ae->sum_feat_sq[index], c + sizeof(index) + sizeof(count), sizeof(float));
+      if (buf_read(cache, c, count * sizeof(feature)) < count * sizeof(feature))
+	return 0;
+      ae->indices.push_back(index);
+      push_many(ae->atomics[index], (feature*)c, count);
+      total += header + count * sizeof(feature);
+
+      if (all->audit || all->hash_inv)
+	{
+	  size_t audit_count;
+	  if (buf_read(cache, c, sizeof(audit_count)) < sizeof(audit_count))
+	    return 0;
+	  memcpy(&audit_count, c, sizeof(audit_count));
+	  for (; audit_count > 0; audit_count--)
+	    {
+	      audit_data a;
+	      if (buf_read(cache, c, sizeof(a.weight_index) + sizeof(a.x)) < sizeof(a.weight_index) + sizeof(a.x))
+		return 0;
+	      memcpy(&a.weight_index, c, sizeof(a.weight_index));
+	      memcpy(&a.x, c + sizeof(a.weight_index), sizeof(a.x));
+	      if (!read_memory_cached_string(cache, ae->audit_strings, a.space)
+		  || !read_memory_cached_string(cache, ae->audit_strings, a.feature))
+		return 0;
+	      a.alloced = false;
+	      ae->audit_features[index].push_back(a);
+	    }
+	}
+    }
+  return (int)total;
+}
+
+void rewind_memory_cache(parser& p)
+{
+  mem_io_buf& cache = *p.memory_cache;
+  if (p.reader != read_memory_cached_features)
+    { // the first pass is over: what was written is what there is to read
+      cache.endloaded = cache.space.end;
+      p.reader = read_memory_cached_features;
+    }
+  cache.space.end = cache.space.begin;
+  cache.current = 0; // buf_read moved past the only "file" at the end of the pass
+}
@@ -14,9 +14,65 @@ const size_t char_size = 2;
 char* run_len_decode(char *p, size_t& i);
 char* run_len_encode(char *p, size_t i);
 
+// Cache files hold blocks of up to cache_block_size examples.  Each block
+// starts with its length in bytes and its number of examples, so a block can
+// be taken out of the input whole and decoded on its own.  An empty block
+// ends the examples; it is followed by an index with the offset and size of
+// every block and a trailer holding the index offset and the number of
+// blocks, so a reader can also seek straight to a block.
+const size_t cache_block_size = 32;
+const char cache_format = 'v'; // follows the version in the header; bump it with the layout
+const size_t cache_block_header_size = sizeof(uint64_t) + sizeof(uint32_t);
+
+struct cache_index_entry {
+  uint64_t offset;
+  uint32_t examples;
+};
+
+// io_buf over memory only: cache blocks are put together in one before they
+// are written out, and decoded in place from one.
+class mem_io_buf : public io_buf
+{
+ public:
+  v_array<char> owned; // our own space, while space aliases a block
+  bool aliased;
+
+  mem_io_buf() { files.push_back(-1); aliased = false; }
+
+  virtual ~mem_io_buf() { if (aliased) space = owned; }
+
+  void set_block(char* begin, size_t bytes) {
+    if (!aliased)
+      owned = space;
+    aliased = true;
+    space.begin = space.end = begin;
+    space.end_array = endloaded = begin + bytes;
+  }
+
+  virtual size_t fill(int) { return 0; }
+  virtual void shift_space() {}
+  virtual void flush() { space.resize(2 * (space.end_array - space.begin)); } // grow rather than write out
+};
+
+struct vw;
+struct parser;
+
+int read_cached_example(vw& all, io_buf& input, example* ec);
 int read_cached_features(void*a, example* ec);
+int read_cached_block_features(void* a, example* ec);
+char* read_cache_block_header(io_buf& input, uint64_t& bytes, uint32_t& examples);
+void cache_example(vw& all, example* ae);
+void finish_cache(parser& p);
+void seek_cache(vw& all, int f, size_t skip);
 void cache_tag(io_buf& cache, v_array<char> tag);
-void cache_features(io_buf& cache, example* ae, uint32_t mask);
+
+// --cache_in_memory keeps the examples of the first pass in a mem_io_buf,
+// with their features and audit features as parsed, so later passes copy
+// them back instead of reading and decoding a cache.
+void memory_cache_example(vw& all, example* ae);
+int read_memory_cached_features(void* in, example* ec);
+void rewind_memory_cache(parser& p);
+void cache_features(io_buf& cache, example* ae, size_t mask);
 void output_byte(io_buf& cache, unsigned char s);
-void output_features(io_buf& cache, unsigned char index, feature* begin, feature* end, uint32_t mask);
+void output_features(io_buf& cache, unsigned char index, feature* begin, feature* end, size_t mask);
 
@@ -0,0 +1,248 @@
+/*
+Copyright (c) by respective owners including Yahoo!, Microsoft, and
+individual contributors. All rights reserved.  Released under a BSD
+license as described in the file LICENSE.
+ */
+#include <string.h>
+#include <algorithm>
+#ifdef _WIN32
+#include <WinSock2.h>
+#else
+#include <pthread.h>
+#endif
+#include "zlib.h"
+#include "chunked_model.h"
+
+using namespace std;
+
+const size_t max_gap_bytes = 10;
+const uint32_t max_chunk_stride = 1024;
+
+struct chunk_job {
+  chunked_rows* r;
+  bool read;
+  uint64_t first; // rows first to end
+  uint64_t end;
+  v_array<unsigned char> raw;
+  v_array<unsigned char> packed;
+  uint32_t raw_bytes;
+  uint32_t packed_bytes; // raw_bytes when the chunk is stored as it is
+  bool failed;
+#ifndef _WIN32
+  pthread_t thread;
+#else
+  HANDLE thread;
+#endif
+};
+
+static void reserve(v_array<unsigned char>& a, size_t bytes)
+{
+  if ((size_t)(a.end_array - a.begin) < bytes)
+    a.resize(bytes);
+}
+
+static void encode_chunk(chunk_job& j)
+{
+  chunked_rows& r = *j.r;
+  size_t row_bytes = r.stride * sizeof(weight);
+  reserve(j.raw, (size_t)(j.end - j.first) * (max_gap_bytes + row_bytes));
+  unsigned char* p = j.raw.begin;
+  uint64_t next = j.first;
+  weight row[max_chunk_stride];
+  for (uint64_t i = j.first; i < j.end; i++)
+    if (r.get(r.data, i, row))
+      {
+	for (uint64_t gap = i - next; ; gap >>= 7)
+	  {
+	    if (gap < 0x80)
+	      {
+		*p++ = (unsigned char)gap;
+		break;
+	      }
+	    *p++ = (unsigned char)(gap | 0x80);
+	  }
+	memcpy(p, row, row_bytes);
+	p += row_bytes;
+	next = i + 1;
+      }
+  j.raw_bytes = (uint32_t)(p - j.raw.begin);
+
+  uLongf packed_bytes = compressBound(j.raw_bytes);
+  reserve(j.packed, packed_bytes);
+  if (compress2(j.packed.begin, &packed_bytes, j.raw.begin, j.raw_bytes, Z_BEST_SPEED) == Z_OK
+      && packed_bytes < j.raw_bytes)
+    j.packed_bytes = (uint32_t)packed_bytes;
+  else
+    j.packed_bytes = j.raw_bytes;
+}
+
+// the rows of a chunk, or false if it is not one this section could hold
+static bool decode_chunk(chunk_job& j)
+{
+  chunked_rows& r = *j.r;
+  const unsigned char* p = j.packed.begin;
+  if (j.packed_bytes != j.raw_bytes)
+    {
+      reserve(j.raw, j.raw_bytes);
+      uLongf raw_bytes = j.raw_bytes;
+      if (uncompress(j.raw.begin, &raw_bytes, j.packed.begin, j.packed_bytes) != Z_OK || raw_bytes != j.raw_bytes)
+	return false;
+      p = j.raw.begin;
+    }
+  const unsigned char* end = p + j.raw_bytes;
+  size_t row_bytes = r.stride * sizeof(weight);
+  weight row[max_chunk_stride];
+  uint64_t next = j.first;
+  while (p < end)
+    {
+      uint64_t gap = 0;
+      for (int shift = 0; ; shift += 7)
+	{
+	  if (p == end || shift > 63)
+	    return false;
+	  unsigned char b = *p++;
+	  gap |= (uint64_t)(b & 0x7f) << shift;
+	  if (b < 0x80)
+	    break;
+	}
+      if (gap >= j.end - next || (size_t)(end - p) < row_bytes)
+	return false;
+      memcpy(row, p, row_bytes); // p need not be aligned
+      p += row_bytes;
+      r.set(r.data, next + gap, row, r.stride);
+      next += gap + 1;
+    }
+  return true;
+}
+
+static void run_chunk(chunk_job& j)
+{
+  if (!j.read)
+    encode_chunk(j);
+  else if (!j.r->serial)
+    j.failed = !decode_chunk(j);
+}
+
+#ifdef _WIN32
+DWORD WINAPI chunk_thread(LPVOID in)
+#else
+void *chunk_thread(void *in)
+#endif
+{
+  run_chunk(*(chunk_job*)in);
+#ifndef _WIN32
+  return nullptr;
+#else
+  return 0L;
+#endif
+}
+
+// the jobs on threads of their own but the first, which is the caller's
+static void run_chunks(chunk_job* jobs, size_t count)
+{
+  for (size_t t = 1; t < count; t++)
+#ifndef _WIN32
+    pthread_create(&jobs[t].thread, nullptr, chunk_thread, &jobs[t]);
+#else
+    jobs[t].thread = ::CreateThread(nullptr, 0, static_cast<LPTHREAD_START_ROUTINE>(chunk_thread), &jobs[t], 0L, nullptr);
+#endif
+  run_chunk(jobs[0]);
+  for (size_t t = 1; t < count; t++)
+#ifndef _WIN32
+    pthread_join(jobs[t].thread, nullptr);
+#else
+    {
+      WaitForSingleObject(jobs[t].thread, INFINITE);
+      CloseHandle(jobs[t].thread);
+    }
+#endif
+}
+
+void save_load_chunked(vw& all, io_buf& model_file, bool read, chunked_rows& r)
+{
+  uint64_t rows = r.rows;
+  uint32_t stride = r.stride;
+  uint32_t rows_per_chunk = chunk_rows;
+  bin_text_read_write_fixed(model_file, (char*)&rows, sizeof(rows), "", read, "", 0, false);
+  bin_text_read_write_fixed(model_file, (char*)&stride, sizeof(stride), "", read, "", 0, false);
+  bin_text_read_write_fixed(model_file, (char*)&rows_per_chunk, sizeof(rows_per_chunk), "", read, "", 0, false);
+  if (!read && stride > max_chunk_stride)
+    {
+      cerr << "error: rows of " << stride << " weights are too long for --chunked_model" << endl;
+      throw exception();
+    }
+  if (read && (rows != r.rows || stride == 0 || stride > max_chunk_stride || rows_per_chunk == 0))
+    {
+      cerr << "error: the chunks of the model do not match its header, bad model format" << endl;
+      throw exception();
+    }
+  r.stride = stride;
+
+  size_t threads = max(all.model_threads, (size_t)1);
+  chunk_job* jobs = calloc_or_die<chunk_job>(threads);
+  for (size_t t = 0; t < threads; t++)
+    {
+      jobs[t].r = &r;
+      jobs[t].read = read;
+      jobs[t].raw = v_init<unsigned char>();
+      jobs[t].packed = v_init<unsigned char>();
+    }
+
+  bool failed = false;
+  for (uint64_t first = 0; first < rows && !failed; first += (uint64_t)rows_per_chunk * threads)
+    {
+      size_t count = 0;
+      for (; count < threads && first + (uint64_t)count * rows_per_chunk < rows; count++)
+	{
+	  chunk_job& j = jobs[count];
+	  j.first = first + (uint64_t)count * rows_per_chunk;
+	  j.end = min(j.first + rows_per_chunk, rows);
+	  if (read)
+	    {
+	      size_t brw = bin_read_fixed(model_file, (char*)&j.raw_bytes, sizeof(j.raw_bytes), "");
+	      brw += bin_read_fixed(model_file, (char*)&j.packed_bytes, sizeof(j.packed_bytes), "");
+	      if (brw < sizeof(j.raw_bytes) + sizeof(j.packed_bytes) || j.packed_bytes > j.raw_bytes
+		  || j.raw_bytes > (j.end - j.first) * (max_gap_bytes + stride * sizeof(weight)))
+		failed = true;
+	      else
+		{
+		  reserve(j.packed, j.packed_bytes);
+		  failed = bin_read_fixed(model_file, (char*)j.packed.begin, j.packed_bytes, "") < j.packed_bytes;
+		}
+	      if (failed)
+		break;
+	    }
+	}
+      if (failed)
+	break;
+
+      run_chunks(jobs, count);
+
+      for (size_t t = 0; t < count; t++)
+	{
+	  chunk_job& j = jobs[t];
+	  if (!read)
+	    {
+	      bin_write_fixed(model_file, (char*)&j.raw_bytes, sizeof(j.raw_bytes));
+	      bin_write_fixed(model_file, (char*)&j.packed_bytes, sizeof(j.packed_bytes));
+	      bin_write_fixed(model_file, (char*)(j.packed_bytes < j.raw_bytes ? j.packed.begin : j.raw.begin), j.packed_bytes);
+	    }
+	  else if (r.serial)
+	    failed |= !decode_chunk(j);
+	  else
+	    failed |= j.failed;
+	}
+    }
+
+  for (size_t t = 0; t < threads; t++)
+    {
+      jobs[t].raw.delete_v();
+      jobs[t].packed.delete_v();
+    }
+  free(jobs);
+  if (failed)
+    {
+      cerr << "error: a chunk of the model's weights is damaged or missing, bad model format" << endl;
+      throw exception();
+    }
+}
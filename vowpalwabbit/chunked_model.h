@@ -0,0 +1,32 @@
+/*
+Copyright (c) by respective owners including Yahoo!, Microsoft, and
+individual contributors. All rights reserved.  Released under a BSD
+license as described in the file LICENSE.
+ */
+#pragma once
+#include <stdint.h>
+#include "global_data.h"
+
+// --chunked_model saves an array of rows (the weights, or each weight and
+// its state with --save_resume) as chunks of chunk_rows rows, each holding
+// the rows that are kept, as the gaps between their numbers and their
+// floats, compressed with zlib.  A chunk is encoded and compressed, or
+// inflated and decoded, by one of --model_threads threads, so a round of
+// that many chunks is worked on at once while the file is read or written
+// in order between rounds.
+
+const uint32_t chunk_rows = 1 << 16;
+
+struct chunked_rows {
+  uint64_t rows;
+  uint32_t stride; // floats per row in the file, once read from it when loading
+  void* data;
+  // copies row i out for saving, false if it is left out
+  bool (*get)(void* data, uint64_t i, weight* row);
+  // stores a row of stride floats read back; called from several threads
+  // at once, on rows of different chunks, unless serial
+  void (*set)(void* data, uint64_t i, const weight* row, uint32_t stride);
+  bool serial;
+};
+
+void save_load_chunked(vw& all, io_buf& model_file, bool read, chunked_rows& r);
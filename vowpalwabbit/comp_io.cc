@@ -0,0 +1,387 @@
+/*
+Copyright (c) by respective owners including Yahoo!, Microsoft, and
+individual contributors. All rights reserved.  Released under a BSD (revised)
+license as described in the file LICENSE.
+ */
+#ifdef _WIN32
+#include <winsock2.h>
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "comp_io.h"
+#include "parse_primitives.h"
+#include "memory.h"
+
+// Compressed input is inflated ahead of the parser by background threads.
+// The inflated bytes go into a ring of slots which read_file drains in
+// order.  For BGZF files (bgzip output, also written by samtools and
+// friends) every member carries its compressed size, so the reader thread
+// just cuts the file into runs of members and several threads inflate them
+// at once.  Any other gzip stream has to be inflated front to back, so one
+// thread runs gzread a slot ahead of the parser.
+
+const size_t gz_slot_size = 1 << 20; // bytes per slot, inflated or compressed
+const size_t max_inflaters = 8;
+
+enum gz_slot_state { SLOT_FREE, SLOT_COMPRESSED, SLOT_INFLATING, SLOT_READY };
+
+struct gz_slot {
+  gz_slot_state state;
+  v_array<char> in; // bgzf members still to inflate
+  v_array<char> out;
+  size_t taken; // bytes of out already returned by read_file
+  bool last; // the input ends with this slot
+};
+
+struct gz_reader;
+
+struct gz_thread {
+  gz_reader* reader;
+#ifndef _WIN32
+  pthread_t thread;
+#else
+  HANDLE thread;
+#endif
+};
+
+struct gz_reader {
+  gzFile fil; // the stream when it isn't bgzf
+  int fd; // the raw bgzf file, -1 otherwise
+
+  gz_slot* slots;
+  size_t num_slots;
+  uint64_t produced; // slots filled by the reader thread
+  uint64_t inflated; // next slot for an inflater to take
+  uint64_t consumed; // slot read_file is draining
+
+  gz_thread* threads; // the reader thread, then the inflaters
+  size_t num_threads;
+  bool stop;
+  MUTEX lock;
+  CV changed;
+};
+
+size_t read_fully(int fd, char* buf, size_t nbytes)
+{
+  size_t got = 0;
+  while (got < nbytes)
+    {
+      ssize_t r = io_buf::read_file_or_socket(fd, buf + got, nbytes - got);
+      if (r <= 0)
+	break;
+      got += r;
+    }
+  return got;
+}
+
+// appends one bgzf member to in; false at the end of the file
+bool read_bgzf_member(int fd, v_array<char>& in)
+{
+  const size_t header_size = 12;
+  size_t at = in.size();
+  if (in.end_array - in.end < (ptrdiff_t)header_size)
+    in.resize(2 * (in.end_array - in.begin) + header_size);
+  if (read_fully(fd, in.end, header_size) < header_size)
+    return false;
+
+  unsigned char* h = (unsigned char*)in.end;
+  size_t xlen = h[10] | (h[11] << 8);
+  in.end += header_size;
+  if (in.end_array - in.end < (ptrdiff_t)xlen)
+    in.resize(in.size() + xlen);
+  if (read_fully(fd, in.end, xlen) < xlen)
+    return false;
+
+  size_t block_size = 0;
+  for (unsigned char* x = (unsigned char*)in.end; x + 4 <= (unsigned char*)in.end + xlen; x += 4 + (x[2] | (x[3] << 8)))
+    if (x[0] == 'B' && x[1] == 'C' && (x[2] | (x[3] << 8)) == 2 && x + 6 <= (unsigned char*)in.end + xlen)
+      block_size = (x[4] | (x[5] << 8)) + 1;
+  in.end += xlen;
+  if (block_size < header_size + xlen)
+    {
+      std::cerr << "bad bgzf block, ignoring the rest of the input" << std::endl;
+      in.end = in.begin + at;
+      return false;
+    }
+
+  size_t rest = block_size - header_size - xlen;
+  if (in.end_array - in.end < (ptrdiff_t)rest)
+    in.resize(in.size() + rest);
+  if (read_fully(fd, in.end, rest) < rest)
+    {
+      in.end = in.begin + at;
+      return false;
+    }
+  in.end += rest;
+  return true;
+}
+
+// inflates the concatenated gzip members in in into out
+void inflate_members(v_array<char>& in, v_array<char>& out)
+{
+  out.erase();
+  if (in.size() == 0)
+    return;
+  if ((size_t)(out.end_array - out.begin) < 4 * in.size())
+    out.resize(4 * in.size());
+
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  inflateInit2(&zs, 15 + 16);
+  zs.next_in = (Bytef*)in.begin;
+  zs.avail_in = (uInt)in.size();
+  while (zs.avail_in > 0)
+    {
+      if (out.end == out.end_array)
+	out.resize(2 * (out.end_array - out.begin));
+      zs.next_out = (Bytef*)out.end;
+      zs.avail_out = (uInt)(out.end_array - out.end);
+      int ret = inflate(&zs, Z_NO_FLUSH);
+      out.end = (char*)zs.next_out;
+      if (ret == Z_STREAM_END)
+	inflateReset(&zs);
+      else if (ret != Z_OK && ret != Z_BUF_ERROR)
+	{
+	  std::cerr << "error inflating compressed input: " << (zs.msg ? zs.msg : "") << std::endl;
+	  break;
+	}
+      else if (ret == Z_BUF_ERROR && zs.avail_out > 0)
+	break; // truncated member
+    }
+  inflateEnd(&zs);
+}
+
+void gz_reader_loop(gz_reader& r)
+{
+  for (uint64_t seq = 0; ; seq++)
+    {
+      gz_slot& slot = r.slots[seq % r.num_slots];
+      mutex_lock(&r.lock);
+      while (slot.state != SLOT_FREE && !r.stop)
+	condition_variable_wait(&r.changed, &r.lock);
+      bool stop = r.stop;
+      mutex_unlock(&r.lock);
+      if (stop)
+	return;
+
+      bool last = false;
+      if (r.fd != -1)
+	{
+	  slot.in.erase();
+	  while (slot.in.size() < gz_slot_size && !last)
+	    last = !read_bgzf_member(r.fd, slot.in);
+	}
+      else
+	{
+	  if ((size_t)(slot.out.end_array - slot.out.begin) < gz_slot_size)
+	    slot.out.resize(gz_slot_size);
+	  int num_read = gzread(r.fil, slot.out.begin, (unsigned int)gz_slot_size);
+	  slot.out.end = slot.out.begin + (num_read > 0 ? num_read : 0);
+	  last = num_read <= 0;
+	}
+
+      mutex_lock(&r.lock);
+      slot.taken = 0;
+      slot.last = last;
+      slot.state = r.fd != -1 ? SLOT_COMPRESSED : SLOT_READY;
+      r.produced++;
+      condition_variable_signal_all(&r.changed);
+      mutex_unlock(&r.lock);
+      if (last)
+	return;
+    }
+}
+
+void gz_inflate_loop(gz_reader& r)
+{
+  while (true)
+    {
+      mutex_lock(&r.lock);
+      while (!r.stop && r.inflated == r.produced)
+	condition_variable_wait(&r.changed, &r.lock);
+      if (r.stop)
+	{
+	  mutex_unlock(&r.lock);
+	  return;
+	}
+      gz_slot& slot = r.slots[r.inflated++ % r.num_slots];
+      slot.state = SLOT_INFLATING;
+      mutex_unlock(&r.lock);
+
+      inflate_members(slot.in, slot.out);
+
+      mutex_lock(&r.lock);
+      slot.state = SLOT_READY;
+      condition_variable_signal_all(&r.changed);
+      mutex_unlock(&r.lock);
+    }
+}
+
+#ifdef _WIN32
+DWORD WINAPI gz_thread_loop(LPVOID in)
+#else
+void *gz_thread_loop(void *in)
+#endif
+{
+  gz_thread* t = (gz_thread*)in;
+  if (t == t->reader->threads)
+    gz_reader_loop(*t->reader);
+  else
+    gz_inflate_loop(*t->reader);
+  return 0L;
+}
+
+size_t num_inflaters()
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  size_t cpus = info.dwNumberOfProcessors;
+#else
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if (cpus < 1)
+    return 1;
+  return min((size_t)cpus, max_inflaters);
+}
+
+void start_threads(gz_reader& r)
+{
+  r.produced = r.inflated = r.consumed = 0;
+  r.stop = false;
+  for (size_t i = 0; i < r.num_slots; i++)
+    {
+      r.slots[i].state = SLOT_FREE;
+      r.slots[i].taken = 0;
+      r.slots[i].last = false;
+    }
+  for (size_t i = 0; i < r.num_threads; i++)
+    {
+      gz_thread& t = r.threads[i];
+      t.reader = &r;
+#ifndef _WIN32
+      pthread_create(&t.thread, nullptr, gz_thread_loop, &t);
+#else
+      t.thread = ::CreateThread(nullptr, 0, static_cast<LPTHREAD_START_ROUTINE>(gz_thread_loop), &t, 0L, nullptr);
+#endif
+    }
+}
+
+void stop_threads(gz_reader& r)
+{
+  mutex_lock(&r.lock);
+  r.stop = true;
+  condition_variable_signal_all(&r.changed);
+  mutex_unlock(&r.lock);
+  for (size_t i = 0; i < r.num_threads; i++)
+    {
+#ifndef _WIN32
+      pthread_join(r.threads[i].thread, nullptr);
+#else
+      ::WaitForSingleObject(r.threads[i].thread, INFINITE);
+      ::CloseHandle(r.threads[i].thread);
+#endif
+    }
+}
+
+int open_bgzf(const char* name)
+{
+  int fd;
+#ifdef _WIN32
+  _sopen_s(&fd, name, _O_RDONLY|_O_BINARY|_O_SEQUENTIAL, _SH_DENYWR, 0);
+#else
+  fd = open(name, O_RDONLY|O_LARGEFILE);
+#endif
+  if (fd == -1)
+    return -1;
+
+  // gzip magic, deflate, FEXTRA set, and a 'BC' subfield of length 2 first
+  unsigned char h[16];
+  bool bgzf = read_fully(fd, (char*)h, sizeof(h)) == sizeof(h)
+    && h[0] == 31 && h[1] == 139 && h[2] == 8 && (h[3] & 4) != 0
+    && h[12] == 'B' && h[13] == 'C' && h[14] == 2 && h[15] == 0;
+  if (!bgzf)
+    {
+      io_buf::close_file_or_socket(fd);
+      return -1;
+    }
+#ifdef _WIN32
+  _lseek(fd, 0, SEEK_SET);
+#else
+  lseek(fd, 0, SEEK_SET);
+#endif
+  return fd;
+}
+
+gz_reader* start_gz_reader(gzFile fil, int fd)
+{
+  gz_reader& r = calloc_or_die<gz_reader>();
+  r.fil = fil;
+  r.fd = fd;
+  r.num_threads = fd != -1 ? 1 + num_inflaters() : 1;
+  r.num_slots = fd != -1 ? 2 * r.num_threads : 2;
+  r.slots = calloc_or_die<gz_slot>(r.num_slots);
+  r.threads = calloc_or_die<gz_thread>(r.num_threads);
+  initialize_mutex(&r.lock);
+  initialize_condition_variable(&r.changed);
+  start_threads(r);
+  return &r;
+}
+
+void reset_gz_reader(gz_reader* r)
+{
+  stop_threads(*r);
+  if (r->fd != -1)
+#ifdef _WIN32
+    _lseek(r->fd, 0, SEEK_SET);
+#else
+    lseek(r->fd, 0, SEEK_SET);
+#endif
+  else
+    gzseek(r->fil, 0, SEEK_SET);
+  start_threads(*r);
+}
+
+void stop_gz_reader(gz_reader* r)
+{
+  stop_threads(*r);
+  if (r->fd != -1)
+    io_buf::close_file_or_socket(r->fd);
+  for (size_t i = 0; i < r->num_slots; i++)
+    {
+      r->slots[i].in.delete_v();
+      r->slots[i].out.delete_v();
+    }
+  free(r->slots);
+  free(r->threads);
+  delete_mutex(&r->lock);
+  free(r);
+}
+
+ssize_t gz_reader_read(gz_reader* r, void* buf, size_t nbytes)
+{
+  while (true)
+    {
+      gz_slot& slot = r->slots[r->consumed % r->num_slots];
+      mutex_lock(&r->lock);
+      while (slot.state != SLOT_READY)
+	condition_variable_wait(&r->changed, &r->lock);
+      mutex_unlock(&r->lock);
+
+      size_t copy = min(nbytes, slot.out.size() - slot.taken);
+      memcpy(buf, slot.out.begin + slot.taken, copy);
+      slot.taken += copy;
+      if (slot.taken < slot.out.size() || slot.last)
+	return copy;
+
+      mutex_lock(&r->lock);
+      slot.state = SLOT_FREE;
+      r->consumed++;
+      condition_variable_signal_all(&r->changed);
+      mutex_unlock(&r->lock);
+      if (copy > 0)
+	return copy;
+    }
+}
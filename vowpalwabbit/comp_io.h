@@ -8,36 +8,55 @@ license as described in the file LICENSE.
 #include "v_array.h"
 #include "zlib.h"
 #include <stdio.h>
+#include <vector>
+
+// background inflation of a file being read, see comp_io.cc
+struct gz_reader;
+int open_bgzf(const char* name); // a descriptor if name is a bgzf file, -1 otherwise
+gz_reader* start_gz_reader(gzFile fil, int fd); // reads fil, or the bgzf file fd
+void reset_gz_reader(gz_reader* r);
+void stop_gz_reader(gz_reader* r); // also closes a bgzf fd
+ssize_t gz_reader_read(gz_reader* r, void* buf, size_t nbytes);
 
 class comp_io_buf : public io_buf
 {
 public:
   vector<gzFile> gz_files;
+  vector<gz_reader*> readers; // inflating ahead of read_file, nullptr when writing
 
   virtual int open_file(const char* name, bool stdin_off, int flag=READ){
     gzFile fil=nullptr;
     int ret = -1;
     switch(flag){
     case READ:
+      {
+      int bgzf = -1;
       if (*name != '\0')
-	fil = gzopen(name, "rb");
+	{
+	  bgzf = open_bgzf(name);
+	  if (bgzf == -1)
+	    fil = gzopen(name, "rb");
+	}
       else if (!stdin_off)
 #ifdef _WIN32
 	fil = gzdopen(_fileno(stdin), "rb");
 #else
        fil = gzdopen(fileno(stdin), "rb");
 #endif
-       if(fil!=nullptr){
+       if(fil!=nullptr || bgzf!=-1){
 	 gz_files.push_back(fil);
+	 readers.push_back(start_gz_reader(fil, bgzf));
 	 ret = (int)gz_files.size()-1;
 	 files.push_back(ret);
        }
+      }
       break;
 
     case WRITE:
       fil = gzopen(name, "wb");
       if(fil!=nullptr){
         gz_files.push_back(fil);
+        readers.push_back(nullptr);
         ret = (int)gz_files.size()-1;
 	files.push_back(ret);
       }
@@ -50,14 +69,20 @@ public:
   }
 
   virtual void reset_file(int f){
-    gzFile fil = gz_files[f];
-    gzseek(fil, 0, SEEK_SET);
+    if (readers[f] != nullptr)
+      reset_gz_reader(readers[f]);
+    else
+      gzseek(gz_files[f], 0, SEEK_SET);
     endloaded = space.begin;
     space.end = space.begin;
   }
 
+  virtual int64_t seek_file(int, int64_t, int) { return -1; } // gzip is read front to back
+
   virtual ssize_t read_file(int f, void* buf, size_t nbytes)
   {
+    if (readers[f] != nullptr)
+      return gz_reader_read(readers[f], buf, nbytes);
     gzFile fil = gz_files[f];
     int num_read = gzread(fil, buf, (unsigned int)nbytes);
     return (num_read > 0) ? num_read : 0;
@@ -82,7 +107,11 @@ public:
 
   virtual bool close_file(){
     if(gz_files.size()>0){
-      gzclose(gz_files.back());
+      if (readers.back() != nullptr)
+	stop_gz_reader(readers.back());
+      readers.pop_back();
+      if (gz_files.back() != nullptr)
+	gzclose(gz_files.back());
       gz_files.pop_back();
       if (files.size() > 0)
 	files.pop();
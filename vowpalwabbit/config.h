@@ -0,0 +1 @@
+#define PACKAGE_VERSION "7.10.1"
@@ -257,7 +257,7 @@ void compute_wap_values(vector<COST_SENSITIVE::wclass*> costs) {
 // Rather than finding the corresponding namespace and feature in ec,
 // add a new feature with opposite value (but same index) to ec to a special wap_ldf_namespace.
 // This is faster and allows fast undo in unsubtract_example().
-void subtract_feature(example& ec, float feature_value_x, uint32_t weight_index)
+void subtract_feature(example& ec, float feature_value_x, feature_index weight_index)
 {
   feature temp = { -feature_value_x, weight_index };
   ec.atomics[wap_ldf_namespace].push_back(temp);
@@ -268,7 +268,7 @@ void subtract_feature(example& ec, float feature_value_x, uint32_t weight_index)
 void subtract_example(vw& all, example *ec, example *ecsub)
 {
   ec->sum_feat_sq[wap_ldf_namespace] = 0;
-  GD::foreach_feature<example&, uint32_t, subtract_feature>(all, *ecsub, *ec);
+  GD::foreach_feature<example&, feature_index, subtract_feature>(all, *ecsub, *ec);
   ec->indices.push_back(wap_ldf_namespace);
   ec->num_features += ec->atomics[wap_ldf_namespace].size();
   ec->total_sum_feat_sq += ec->sum_feat_sq[wap_ldf_namespace];
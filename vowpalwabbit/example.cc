@@ -40,10 +40,108 @@ audit_data copy_audit_data(audit_data &src) {
   strcpy(dst.feature, src.feature);
   dst.weight_index = src.weight_index;
   dst.x = src.x;
-  dst.alloced = src.alloced;
+  dst.alloced = true;
   return dst;
 }
 
+uint16_t namespace_table::add_slot(unsigned char ns)
+{
+  size_t s = slots++;
+  if (s % namespace_chunk == 0)
+    chunks[s / namespace_chunk] = calloc_or_die<namespace_slot>(namespace_chunk);
+  namespace_slot& n = chunks[s / namespace_chunk][s % namespace_chunk];
+  n.ns = ns;
+  n.features.erase_count = borrowed_space; // opens on the tail of space
+  return slot_of[ns] = (uint16_t)(s + 1);
+}
+
+// Lends the free tail of space to the empty namespace in slot s, after
+// closing the one it was lent to: that one keeps what it has filled, and
+// copies out if it grows again.
+v_array<feature>& namespace_table::open_features(uint16_t s)
+{
+  v_array<feature>& f = at(s).features;
+  if (!(f.erase_count & borrowed_space))
+    return f; // it has an array of its own
+  if (open != 0)
+    {
+      v_array<feature>& last = at(open).features;
+      if (last.erase_count & borrowed_space)
+	{
+	  if (last.begin == space.end && last.end >= space.end && last.end <= space.end_array)
+	    space.end = last.end;
+	  last.end_array = last.end;
+	}
+    }
+  f.begin = f.end = space.end;
+  f.end_array = space.end_array;
+  open = s;
+  return f;
+}
+
+void free_audit(v_array<audit_data>& audit)
+{
+  for (audit_data* a = audit.begin; a != audit.end; a++)
+    if (a->alloced)
+      {
+	free(a->space);
+	free(a->feature);
+	a->alloced = false;
+      }
+}
+
+// Empties every namespace of ec, keeping the space of their arrays.  If
+// the features did not all fit in the shared buffer, it grows to hold
+// them and the namespaces that copied out borrow from it again.
+void clear_namespaces(example& ec)
+{
+  namespace_table& t = ec.atomics;
+  size_t needed = 0;
+  for (uint16_t s = 1; s <= t.slots; s++)
+    {
+      namespace_slot& n = t.at(s);
+      free_audit(n.audit);
+      n.audit.clear();
+      n.sum_feat_sq = 0.;
+      needed += n.features.size();
+    }
+
+  bool grow = needed > (size_t)(t.space.end_array - t.space.begin);
+  if (grow)
+    t.space.resize(max(needed, 2 * (size_t)(t.space.end_array - t.space.begin)));
+  for (uint16_t s = 1; s <= t.slots; s++)
+    {
+      v_array<feature>& f = t.at(s).features;
+      if (f.erase_count & borrowed_space)
+	f.begin = f.end = f.end_array = nullptr;
+      else if (grow)
+	{
+	  f.delete_v();
+	  f.erase_count = borrowed_space;
+	}
+      else
+	f.clear();
+    }
+  t.space.end = t.space.begin;
+  t.open = 0;
+}
+
+void free_namespaces(example& ec)
+{
+  namespace_table& t = ec.atomics;
+  for (uint16_t s = 1; s <= t.slots; s++)
+    {
+      namespace_slot& n = t.at(s);
+      n.features.delete_v();
+      free_audit(n.audit);
+      n.audit.delete_v();
+    }
+  for (size_t c = 0; c * namespace_chunk < t.slots; c++)
+    free(t.chunks[c]);
+  t.space.delete_v();
+  memset(&t, 0, sizeof(t));
+}
+
 namespace VW {
 void copy_example_label(example* dst, example* src, size_t label_size, void(*copy_label)(void*,void*)) {
   if (copy_label)
@@ -59,26 +157,25 @@ void copy_example_data(bool audit, example* dst, example* src)
   dst->example_counter = src->example_counter;
 
   copy_array(dst->indices, src->indices);
-  for (size_t i=0; i<256; i++)
-    copy_array(dst->atomics[i], src->atomics[i]);
-  dst->ft_offset = src->ft_offset;
-
-  if (audit)
-    for (size_t i=0; i<256; i++) {
-      for (size_t j=0; j<dst->audit_features[i].size(); j++)
-        if (dst->audit_features[i][j].alloced) {
-          free(dst->audit_features[i][j].space);
-          free(dst->audit_features[i][j].feature);
-        }
-      copy_array(dst->audit_features[i], src->audit_features[i], copy_audit_data);
+  clear_namespaces(*dst);
+  for (uint16_t s = 1; s <= src->atomics.slots; s++)
+    {
+      namespace_slot& n = src->atomics.at(s);
+      if (n.features.size() > 0)
+	push_many(dst->atomics[n.ns], n.features.begin, n.features.size());
+      if (audit)
+	for (audit_data* a = n.audit.begin; a != n.audit.end; a++)
+	  dst->audit_features[n.ns].push_back(copy_audit_data(*a));
+      if (n.sum_feat_sq != 0.)
+	dst->sum_feat_sq[n.ns] = n.sum_feat_sq;
     }
+  dst->ft_offset = src->ft_offset;
   
   dst->num_features = src->num_features;
   dst->partial_prediction = src->partial_prediction;
   copy_array(dst->topic_predictions, src->topic_predictions);
   dst->loss = src->loss;
   dst->example_t = src->example_t;
-  memcpy(dst->sum_feat_sq, src->sum_feat_sq, 256 * sizeof(float));
   dst->total_sum_feat_sq = src->total_sum_feat_sq;
   dst->revert_weight = src->revert_weight;
   dst->test_only = src->test_only;
@@ -96,13 +193,13 @@ struct features_and_source
 {
   v_array<feature> feature_map; //map to store sparse feature vectors  
   uint32_t stride_shift;
-  uint32_t mask;
+  feature_index mask;
   weight* base;
   vw* all;
 };
 
-void vec_store(features_and_source& p, float fx, uint32_t fi) {    
-  feature f = {fx, (uint32_t)(fi >> p.stride_shift) & p.mask};
+void vec_store(features_and_source& p, float fx, feature_index fi) {    
+  feature f = {fx, (feature_index)(fi >> p.stride_shift) & p.mask};
   p.feature_map.push_back(f);
 }  
 
@@ -111,11 +208,11 @@ namespace VW {
 {
 	features_and_source fs;
 	fs.stride_shift = all.reg.stride_shift;
-	fs.mask = (uint32_t)all.reg.weight_mask >> all.reg.stride_shift;
+	fs.mask = (feature_index)all.reg.weight_mask >> all.reg.stride_shift;
 	fs.base = all.reg.weight_vector;
 	fs.all = &all;
 	fs.feature_map = v_init<feature>();
-	GD::foreach_feature<features_and_source, uint32_t, vec_store>(all, *ec, fs); 		
+	GD::foreach_feature<features_and_source, feature_index, vec_store>(all, *ec, fs); 		
 	feature_map_len = fs.feature_map.size();
 	return fs.feature_map.begin;
 }
@@ -192,22 +289,8 @@ void dealloc_example(void(*delete_label)(void*), example&ec, void(*delete_predic
       
   ec.topic_predictions.delete_v();
 
-  for (size_t j = 0; j < 256; j++)
-    {
-      ec.atomics[j].delete_v();
-
-      if (ec.audit_features[j].begin != ec.audit_features[j].end_array)
-        {
-          for (audit_data* temp = ec.audit_features[j].begin; 
-               temp != ec.audit_features[j].end; temp++)
-            if (temp->alloced) {
-              free(temp->space);
-              free(temp->feature);
-              temp->alloced = false;
-            }
-	  ec.audit_features[j].delete_v();
-        }
-    }
+  free_namespaces(ec);
   ec.indices.delete_v();
+  free_arena(ec.audit_strings);
 }
 
@@ -6,6 +6,7 @@ license as described in the file LICENSE.
 #pragma once
 #include <stdint.h>
 #include "v_array.h"
+#include "arena.h"
 #include "simple_label.h"
 #include "multiclass.h"
 #include "multilabel.h"
@@ -23,9 +24,23 @@ const size_t spelling_namespace  = 133;   // this is \x85
 const size_t conditioning_namespace = 134;
 const size_t dictionary_namespace  = 135;
 
+// The hash of a feature and, once setup_example has run, its weight index.
+// 32 bits allow -b 31 less the bits of the stride.  Building with
+// -DVW_64BIT_INDICES (make INDEX64=1 or configure --enable-64bit-indices)
+// widens them to 64 bits and -b to 61, for a --sparse_weights table of a
+// hash space beyond what collisions allow in 32 bits, at the price of 16
+// byte features.  Code built against the library needs the same setting.
+#ifdef VW_64BIT_INDICES
+typedef uint64_t feature_index;
+const uint32_t max_num_bits = 61;
+#else
+typedef uint32_t feature_index;
+const uint32_t max_num_bits = 31;
+#endif
+
 struct feature {
   float x;
-  uint32_t weight_index;
+  feature_index weight_index;
   bool operator==(feature j){return weight_index == j.weight_index;}
 };
 
@@ -37,6 +52,56 @@ struct audit_data {
   bool alloced;
 };
 
+// The namespaces of an example.  Rather than 256 arrays of each kind, an
+// example has a slot for every namespace it has used, in chunks allocated
+// on first use, and a table from namespace to slot.  The features of all
+// its namespaces share one buffer: a namespace that starts empty borrows
+// the free tail of it, so parsing appends to one contiguous run and
+// clear_namespaces only rewinds it.  A namespace that grows after another
+// one took the tail, or that outgrows the buffer, copies its features out
+// to an array of its own; clear_namespaces then grows the buffer so that
+// they fit again.  atomics[ns], audit_features[ns] and sum_feat_sq[ns]
+// index the table as they did the old arrays, adding a slot if needed.
+struct namespace_slot {
+  v_array<feature> features;
+  v_array<audit_data> audit;
+  float sum_feat_sq;
+  unsigned char ns;
+};
+
+const size_t namespace_chunk = 16; // slots allocated at a time
+
+struct namespace_table {
+  uint16_t slot_of[256]; // 1 + the slot of each namespace, 0 for none yet
+  uint16_t slots; // in use
+  uint16_t open; // 1 + the slot borrowing the tail of space, 0 for none
+  namespace_slot* chunks[256 / namespace_chunk];
+  v_array<feature> space; // shared by the features; space.end is the free tail
+
+  namespace_slot& at(uint16_t s) { return chunks[(s - 1) / namespace_chunk][(s - 1) % namespace_chunk]; }
+  uint16_t find(size_t ns) { uint16_t s = slot_of[ns]; return s != 0 ? s : add_slot((unsigned char)ns); }
+  uint16_t add_slot(unsigned char ns);
+  v_array<feature>& open_features(uint16_t s);
+};
+
+struct namespace_features : public namespace_table {
+  v_array<feature>& operator[](size_t ns) {
+    uint16_t s = find(ns);
+    v_array<feature>& f = at(s).features;
+    if (f.begin != f.end || s == open)
+      return f;
+    return open_features(s);
+  }
+};
+
+struct namespace_audit : public namespace_table {
+  v_array<audit_data>& operator[](size_t ns) { return at(find(ns)).audit; }
+};
+
+struct namespace_sums : public namespace_table {
+  float& operator[](size_t ns) { return at(find(ns)).sum_feat_sq; }
+};
+
 typedef union {
   label_data simple;
   MULTICLASS::label_t multi;
@@ -61,18 +126,15 @@ struct example // core example datatype.
   v_array<char> tag;//An identifier for the example.
   size_t example_counter;
   v_array<unsigned char> indices;
-  v_array<feature> atomics[256]; // raw parsed data
   uint32_t ft_offset;
   
   //helpers
-  v_array<audit_data> audit_features[256];  
   size_t num_features;//precomputed, cause it's fast&easy.
   float partial_prediction;//shared data for prediction.
   float updated_prediction;//estimated post-update prediction.
   v_array<float> topic_predictions;
   float loss;
   float example_t;//sum of importance weights so far.
-  float sum_feat_sq[256];//helper for total_sum_feat_sq.
   float total_sum_feat_sq;//precomputed, cause it's kind of fast & easy.
   float revert_weight;
 
@@ -80,6 +142,13 @@ struct example // core example datatype.
   bool end_pass;//special example indicating end of pass.
   bool sorted;//Are the features sorted or not?
   bool in_use; //in use or not (for the parser)
+
+  union { // three views of one namespace_table
+    namespace_features atomics; // raw parsed data
+    namespace_audit audit_features;
+    namespace_sums sum_feat_sq; //helper for total_sum_feat_sq.
+  };
+  arena audit_strings; // backs the parser's audit_data, which are not alloced
 };
 
  struct vw;  
@@ -107,6 +176,8 @@ void free_flatten_example(flat_example* fec);
 
 example *alloc_examples(size_t,size_t);
 void dealloc_example(void(*delete_label)(void*), example&ec, void(*delete_prediction)(void*) = nullptr);
+void clear_namespaces(example& ec);
+void free_namespaces(example& ec);
 
 inline int example_is_newline(example& ec)
 {
@@ -2,9 +2,10 @@
 #include <stdio.h>
 #include "../vowpalwabbit/parser.h"
 #include "../vowpalwabbit/vw.h"
+#include "../vowpalwabbit/best_constant.h"
 
 using namespace std;
-typedef uint32_t fid;
+typedef feature_index fid;
 
 struct vw_namespace {
   char namespace_letter;
@@ -195,6 +196,8 @@ class ezexample {
     ec->partial_prediction = 0.;
     vw_ref->sd->t += vw_par_ref->p->lp.get_weight(&ec->l);
     ec->example_t = (float)vw_ref->sd->t;
+    if (vw_par_ref->p->lp.parse_label == simple_label.parse_label)
+      count_label(ec->l.simple.label);
 
     ec->num_features      -= quadratic_features_num;
     ec->total_sum_feat_sq -= quadratic_features_sqr;
@@ -40,7 +40,7 @@ void multipredict(ftrl& b, base_learner& base, example& ec, size_t count, size_t
   for (size_t c=0; c<count; c++)
     pred[c].scalar = ec.l.simple.initial;
   GD::multipredict_info mp = { count, step, pred, &all.reg, (float)all.sd->gravity };
-  GD::foreach_feature<GD::multipredict_info, uint32_t, GD::vec_add_multipredict>(all, ec, mp);
+  GD::foreach_feature<GD::multipredict_info, feature_index, GD::vec_add_multipredict>(all, ec, mp);
   if (all.sd->contraction != 1.)
     for (size_t c=0; c<count; c++)
       pred[c].scalar *= (float)all.sd->contraction;
@@ -4,6 +4,7 @@ individual contributors. All rights reserved.  Released under a BSD (revised)
 license as described in the file LICENSE.
  */
 #include <float.h>
+#include <fstream>
 #ifdef _WIN32
 #include <WinSock2.h>
 #else
@@ -22,6 +23,17 @@ license as described in the file LICENSE.
 #include "accumulate.h"
 #include "reductions.h"
 #include "vw.h"
+#include "placement.h"
+#include "quantize.h"
+#include "chunked_model.h"
+#include "parse_regressor.h"
+
+#ifdef VW_GATHER_KERNELS
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
 
 #define VERSION_SAVE_RESUME_FIX "7.10.1"
 
@@ -31,6 +43,61 @@ using namespace LEARNER;
 //4. Factor various state out of vw&
 namespace GD
 {
+#ifdef VW_GATHER_KERNELS
+  // The kernels are compiled for AVX2 whatever -march says and only called
+  // when the cpu we run on has it.
+  static bool cpu_has_avx2()
+  {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+      return false;
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) // the os saves the ymm registers
+      return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+  }
+
+  const bool avx2_kernels = cpu_has_avx2();
+
+#ifndef _MSC_VER
+  __attribute__((target("avx2")))
+#endif
+  float dot_features_avx2(weight* weight_vector, uint32_t weight_mask, feature* begin, feature* end, uint32_t offset, float mult)
+  {
+    __m256i mask = _mm256_set1_epi32((int)weight_mask);
+    __m256i off = _mm256_set1_epi32((int)offset);
+    __m256 m = _mm256_set1_ps(mult);
+    __m256 sum = _mm256_setzero_ps();
+    feature* f = begin;
+    for (; end - f >= 8; f += 8)
+      { // x and weight_index alternate; both shuffles put feature i in the same lane
+        __m256 lo = _mm256_loadu_ps((float*)f);
+        __m256 hi = _mm256_loadu_ps((float*)(f + 4));
+        __m256 x = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256i index = _mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+        index = _mm256_and_si256(_mm256_add_epi32(index, off), mask);
+        __m256 w = _mm256_i32gather_ps(weight_vector, index, 4);
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(w, _mm256_mul_ps(m, x)));
+      }
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    float dot = _mm_cvtss_f32(half);
+    for (; f != end; f++)
+      dot += weight_vector[(f->weight_index + offset) & weight_mask] * (mult * f->x);
+    return dot;
+  }
+#endif
+
+  struct minibatch;
+
   struct gd {
     //double normalized_sum_norm_x;
     double total_weight;
@@ -40,12 +107,21 @@ namespace GD
     float neg_norm_power;
     float neg_power_t;
     float sparse_l2;
-    float update_multiplier;
     void (*predict)(gd&, base_learner&, example&);
     void (*learn)(gd&, base_learner&, example&);
     void (*update)(gd&, base_learner&, example&);
     void (*multipredict)(gd&, base_learner&, example&, size_t, size_t, polyprediction*, bool);
 
+    size_t batch_size; // examples per update, 0 for online updates (--minibatch)
+    minibatch* batch;
+    void (*update_rates)(gd&, minibatch&, size_t);
+    float (*batch_multiplier)(gd&);
+
+    int quantize; // a quantize_mode (--quantize)
+    bool quantize_report;
+    bool sparse; // --sparse_weights
+    bool delta_checkpoints;
+
     vw* all; //parallel, features, parameters
   };
 
@@ -84,15 +160,26 @@ namespace GD
     return x;
   }
   
-  template<bool sqrt_rate, bool feature_mask_off, size_t adaptive, size_t normalized, size_t spare>
-  inline void update_feature(float& update, float x, float& fw)
+  // The w for which w[adaptive], w[normalized] and w[spare] are the update
+  // state of the weight fw: the floats following it, or with --split_weights
+  // its row of the state vector.
+  template<bool split, size_t spare>
+  inline weight* state_of(regressor& reg, float& fw)
+  { return split ? reg.state_vector + (&fw - reg.weight_vector) * spare : &fw; }
+
+  struct update_data {
+    float update;
+    regressor* reg;
+  };
+
+  template<bool sqrt_rate, bool feature_mask_off, bool split, size_t adaptive, size_t normalized, size_t spare>
+  inline void update_feature(update_data& d, float x, float& fw)
   {
-    weight* w = &fw;
     if(feature_mask_off || fw != 0.)
       {
 	if (spare != 0)
-	  x *= w[spare];
-	w[0] += update * x;
+	  x *= state_of<split, spare>(*d.reg, fw)[spare];
+	fw += d.update * x;
       }
   }
 
@@ -115,19 +202,24 @@ namespace GD
     return 1.f;
   }
   
-  template<bool sqrt_rate, bool feature_mask_off, size_t adaptive, size_t normalized, size_t spare>
-  void train(gd& g, example& ec, float update)
+  template<bool sqrt_rate, bool feature_mask_off, bool split, size_t adaptive, size_t normalized, size_t spare>
+  void train(gd& g, example& ec, float update, float update_multiplier)
   {
     if (normalized)
-      update *= g.update_multiplier;
+      update *= update_multiplier;
 
-    foreach_feature<float, update_feature<sqrt_rate, feature_mask_off, adaptive, normalized, spare> >(*g.all, ec, update);
+    update_data d = {update, &g.all->reg};
+    foreach_feature<update_data, update_feature<sqrt_rate, feature_mask_off, split, adaptive, normalized, spare> >(*g.all, ec, d);
   }
 
+  void apply_batch(gd& g);
+
   void end_pass(gd& g)
   {
     vw& all = *g.all;
     
+    if (g.batch != nullptr)
+      apply_batch(g);
     sync_weights(all);
     if(all.span_server != "") {
       if(all.adaptive)
@@ -176,7 +268,7 @@ bool operator<(const string_value& first, const string_value& second)
 { 
   ostringstream tempstream;
   size_t index = (f->weight_index + offset) & all.reg.weight_mask;
-  weight* weights = all.reg.weight_vector;
+  weight w = read_weight(all.reg, index);
   size_t stride_shift = all.reg.stride_shift;
   
   if(all.audit) tempstream << prepend;
@@ -197,7 +289,7 @@ bool operator<(const string_value& first, const string_value& second)
   }  
   if(all.audit){
     tempstream << ((index >> stride_shift) & all.parse_mask) << ':' << mult*f->x;
-    tempstream  << ':' << trunc_weight(weights[index], (float)all.sd->gravity) * (float)all.sd->contraction;
+    tempstream  << ':' << trunc_weight(w, (float)all.sd->gravity) * (float)all.sd->contraction;
   }
   if(all.current_pass == 0 && all.inv_hash_regressor_name != ""){ //for invert_hash
     if ( index == (((constant << stride_shift) * all.wpp + offset )& all.reg.weight_mask))
@@ -213,8 +305,8 @@ bool operator<(const string_value& first, const string_value& second)
   }
 
   if(all.adaptive && all.audit)
-    tempstream << '@' << weights[index+1];
-  string_value sv = {weights[index]*f->x, tempstream.str()};
+    tempstream << '@' << (all.reg.state_vector != nullptr ? all.reg.state_vector[index * all.reg.state_stride + 1] : read_weight(all.reg, index+1));
+  string_value sv = {w*f->x, tempstream.str()};
   results.push_back(sv);
 }
 
@@ -227,42 +319,36 @@ bool operator<(const string_value& first, const string_value& second)
       audit_feature(all, & fs[j], nullptr, results, prepend, ns_pre, offset, mult);
 }
 
-void audit_quad(vw& all, feature& left_feature, audit_data* left_audit, v_array<feature> &right_features, v_array<audit_data> &audit_right, vector<string_value>& results, string& ns_pre, uint32_t offset = 0)
-{
-  size_t halfhash = quadratic_constant * (left_feature.weight_index + offset);
-
-  ostringstream tempstream;
-  if (audit_right.size() != 0 && left_audit && all.audit)
-    tempstream << left_audit->space << '^' << left_audit->feature << '^';
-  string prepend = tempstream.str();
-
-  if(all.current_pass == 0 && audit_right.size() != 0 && left_audit)//for invert_hash
-  {
-    ns_pre = left_audit->space; 
-    ns_pre = ns_pre + '^' + left_audit->feature + '^';
-  }
- 
-  audit_features(all, right_features, audit_right, results, prepend, ns_pre, halfhash + offset, left_audit ? left_audit->x : 1);
-}
-
-void audit_triple(vw& all, feature& f0, audit_data* f0_audit, feature& f1, audit_data* f1_audit, 
-		  v_array<feature> &right_features, v_array<audit_data> &audit_right, vector<string_value>& results, string& ns_pre, uint32_t offset = 0)
-{
-  size_t halfhash = cubic_constant2 * (cubic_constant * (f0.weight_index + offset) + f1.weight_index + offset);
-
-  ostringstream tempstream;
-  if (audit_right.size() > 0 && f0_audit && f1_audit && all.audit)
-    tempstream << f0_audit->space << '^' << f0_audit->feature << '^' 
-	       << f1_audit->space << '^' << f1_audit->feature << '^';
-  string prepend = tempstream.str();
+  struct audit_sweep {
+    vw& all;
+    example& ec;
+    vector<string_value>& results;
+    string& ns_pre;
+    void operator()(const string& term, size_t arity, feature** outer, feature* begin, feature* end, feature_index halfhash, float mult)
+    {
+      v_array<feature>& right_features = ec.atomics[(unsigned char)term[arity-1]];
+      v_array<audit_data>& audit_right = ec.audit_features[(unsigned char)term[arity-1]];
+      bool named = audit_right.size() != 0;
+      string names;
+      for (size_t k = 0; k + 1 < arity; k++)
+	{
+	  v_array<audit_data>& as = ec.audit_features[(unsigned char)term[k]];
+	  if (as.size() == 0)
+	    {
+	      named = false;
+	      break;
+	    }
+	  audit_data& a = as[outer[k] - ec.atomics[(unsigned char)term[k]].begin];
+	  names = names + a.space + '^' + a.feature + '^';
+	}
+      string prepend = named && all.audit ? names : "";
+      if(all.current_pass == 0 && named)//for invert_hash
+	ns_pre = names;
 
-  if(all.current_pass == 0 && audit_right.size() != 0 && f0_audit && f1_audit)//for invert_hash
-  {
-    ns_pre = f0_audit->space;
-    ns_pre = ns_pre + '^' + f0_audit->feature + '^' + f1_audit->space + '^' + f1_audit->feature + '^';
-  }
-  audit_features(all, right_features, audit_right, results, prepend, ns_pre, halfhash + offset);  
-}
+      for (feature* f = begin; f != end; f++)
+	audit_feature(all, f, named ? &audit_right[f - right_features.begin] : nullptr, results, prepend, ns_pre, halfhash + ec.ft_offset, mult);
+    }
+  };
 
 void print_features(vw& all, example& ec)
 {
@@ -293,38 +379,8 @@ void print_features(vw& all, example& ec)
 	audit_features(all, ec.atomics[*i], ec.audit_features[*i], features, empty, ns_pre, ec.ft_offset);
         ns_pre = "";
       }
-      for (vector<string>::iterator i = all.pairs.begin(); i != all.pairs.end();i++) 
-	{
-	  unsigned char fst = (*i)[0];
-	  unsigned char snd = (*i)[1];
-	  for (size_t j = 0; j < ec.atomics[fst].size(); j++)
-	    {
-	      audit_data* a = nullptr;
-	      if (ec.audit_features[fst].size() > 0)
-		a = & ec.audit_features[fst][j];
-	      audit_quad(all, ec.atomics[fst][j], a, ec.atomics[snd], ec.audit_features[snd], features, ns_pre);
-	    }
-	}
-
-      for (vector<string>::iterator i = all.triples.begin(); i != all.triples.end();i++) 
-	{
-	  unsigned char fst = (*i)[0];
-	  unsigned char snd = (*i)[1];
-	  unsigned char trd = (*i)[2];
-	  for (size_t j = 0; j < ec.atomics[fst].size(); j++)
-	    {
-	      audit_data* a1 = nullptr;
-	      if (ec.audit_features[fst].size() > 0)
-		a1 = & ec.audit_features[fst][j];
-	      for (size_t k = 0; k < ec.atomics[snd].size(); k++)
-		{
-		  audit_data* a2 = nullptr;
-		  if (ec.audit_features[snd].size() > 0)
-		    a2 = & ec.audit_features[snd][k];
-		  audit_triple(all, ec.atomics[fst][j], a1, ec.atomics[snd][k], a2, ec.atomics[trd], ec.audit_features[trd], features, ns_pre);
-		}
-	    }
-	}
+      audit_sweep sweep = {all, ec, features, ns_pre};
+      INTERACTIONS::foreach_interaction(all, ec, sweep);
 
       sort(features.begin(),features.end());
       if(all.audit){
@@ -369,6 +425,9 @@ float finalize_prediction(shared_data* sd, float ret)
    p.prediction += trunc_weight(fw, p.gravity) * fx;
  }
 
+ template <>
+ struct reads_weights<trunc_data, vec_add_trunc> { static const bool value = true; };
+
  inline float trunc_predict(vw& all, example& ec, double gravity)
  {
    trunc_data temp = {ec.l.simple.initial, (float)gravity};
@@ -392,7 +451,65 @@ void predict(gd& g, base_learner& base, example& ec)
     print_audit_features(all, ec);
 }
 
-inline void vec_add_trunc_multipredict(multipredict_info& mp, const float fx, uint32_t fi) {
+  // The prediction of foreach_feature<float, vec_add> from the compact
+  // weights of --quantize, which W widens as they are read.
+  template <class W>
+  inline void dot_quantized(const W& w, size_t weight_mask, feature* begin, feature* end, float& dat, feature_index offset, float mult = 1.)
+  {
+    for (feature* f = begin; f != end; f++)
+      dat += w[(f->weight_index + offset) & weight_mask] * (mult * f->x);
+  }
+
+  template <class W>
+  struct quantized_sweep {
+    const W& w;
+    size_t weight_mask;
+    uint32_t offset;
+    float& dat;
+    inline void operator()(const string&, size_t, feature**, feature* begin, feature* end, feature_index halfhash, float mult)
+    { dot_quantized(w, weight_mask, begin, end, dat, halfhash + offset, mult); }
+  };
+
+  template <class W>
+  float quantized_predict(vw& all, example& ec, const W& w)
+  {
+    float dat = ec.l.simple.initial;
+    uint32_t offset = ec.ft_offset;
+    for (unsigned char* i = ec.indices.begin; i != ec.indices.end; i++)
+      dot_quantized(w, all.reg.weight_mask, ec.atomics[*i].begin, ec.atomics[*i].end, dat, offset);
+
+    quantized_sweep<W> sweep = {w, all.reg.weight_mask, offset, dat};
+    INTERACTIONS::foreach_interaction(all, ec, sweep);
+    return dat;
+  }
+
+template<class W, bool report>
+void predict_quantized(gd& g, base_learner& base, example& ec)
+{
+  vw& all = *g.all;
+  W w(*all.reg.quantized);
+  ec.partial_prediction = quantized_predict(all, ec, w);
+  ec.pred.scalar = finalize_prediction(all.sd, ec.partial_prediction);
+  if (report)
+    report_quantized(all, ec, finalize_prediction(all.sd, inline_predict(all, ec)), ec.pred.scalar);
+}
+
+template<class W>
+void set_predict_quantized(gd& g, bool report)
+{
+  if (report)
+    g.predict = predict_quantized<W, true>;
+  else
+    g.predict = predict_quantized<W, false>;
+}
+
+void finish_quantized(gd& g)
+{ finish_quantized(*g.all); }
+
+void finish_sparse(gd& g)
+{ free_sparse_weights(*g.all); }
+
+inline void vec_add_trunc_multipredict(multipredict_info& mp, const float fx, feature_index fi) {
   weight*w = mp.reg->weight_vector + (fi & mp.reg->weight_mask);
   for (size_t c=0; c<mp.count; c++) {
     mp.pred[c].scalar += fx * trunc_weight(*w, mp.gravity);
@@ -406,8 +523,8 @@ void multipredict(gd& g, base_learner& base, example& ec, size_t count, size_t s
   for (size_t c=0; c<count; c++)
     pred[c].scalar = ec.l.simple.initial;
   multipredict_info mp = { count, step, pred, &g.all->reg, (float)all.sd->gravity };
-  if (l1) foreach_feature<multipredict_info, uint32_t, vec_add_trunc_multipredict>(all, ec, mp);
-  else    foreach_feature<multipredict_info, uint32_t, vec_add_multipredict      >(all, ec, mp);
+  if (l1) foreach_feature<multipredict_info, feature_index, vec_add_trunc_multipredict>(all, ec, mp);
+  else    foreach_feature<multipredict_info, feature_index, vec_add_multipredict      >(all, ec, mp);
   if (all.sd->contraction != 1.)
     for (size_t c=0; c<count; c++)
       pred[c].scalar *= (float)all.sd->contraction;
@@ -431,9 +548,8 @@ void multipredict(gd& g, base_learner& base, example& ec, size_t count, size_t s
   };
 
   template<bool sqrt_rate, size_t adaptive, size_t normalized>
-  inline float compute_rate_decay(power_data& s, float& fw)
+  inline float compute_rate_decay(power_data& s, weight* w)
   {
-    weight* w = &fw;
     float rate_decay = 1.f;
     if(adaptive) {
       if (sqrt_rate)
@@ -463,12 +579,13 @@ void multipredict(gd& g, base_learner& base, example& ec, size_t count, size_t s
     float pred_per_update;
     float norm_x;
     power_data pd;
+    regressor* reg;
   };
 
-template<bool sqrt_rate, bool feature_mask_off, size_t adaptive, size_t normalized, size_t spare>
+template<bool sqrt_rate, bool feature_mask_off, bool split, size_t adaptive, size_t normalized, size_t spare>
 inline void pred_per_update_feature(norm_data& nd, float x, float& fw) {
   if(feature_mask_off || fw != 0.){
-    weight* w = &fw;
+    weight* w = state_of<split, spare>(*nd.reg, fw);
     float x2 = x * x;
     if(adaptive)
       w[adaptive] += nd.grad_squared * x2;
@@ -478,48 +595,48 @@ inline void pred_per_update_feature(norm_data& nd, float x, float& fw) {
 	if( w[normalized] > 0. ) {//If the normalizer is > 0 then rescale the weight so it's as if the new scale was the old scale.
 	  if (sqrt_rate) {
 	    float rescale = w[normalized]/x_abs;	    
-	    w[0] *= (adaptive ? rescale : rescale*rescale);
+	    fw *= (adaptive ? rescale : rescale*rescale);
 	  }
 	  else {
 	    float rescale = x_abs/w[normalized];	    
-	    w[0] *= powf(rescale*rescale, nd.pd.neg_norm_power);
+	    fw *= powf(rescale*rescale, nd.pd.neg_norm_power);
 	  }
 	}
 	w[normalized] = x_abs;
       }
       nd.norm_x += x2 / (w[normalized] * w[normalized]);
     }
-    w[spare] = compute_rate_decay<sqrt_rate, adaptive, normalized>(nd.pd, fw);
+    w[spare] = compute_rate_decay<sqrt_rate, adaptive, normalized>(nd.pd, w);
 
     nd.pred_per_update += x2 * w[spare];
   }
 }
   
-template<bool sqrt_rate, bool feature_mask_off, size_t adaptive, size_t normalized, size_t spare>
-  float get_pred_per_update(gd& g, example& ec)
+template<bool sqrt_rate, bool feature_mask_off, bool split, size_t adaptive, size_t normalized, size_t spare>
+  float get_pred_per_update(gd& g, example& ec, float& update_multiplier)
   {//We must traverse the features in _precisely_ the same order as during training.
     label_data& ld = ec.l.simple;
     vw& all = *g.all;
     float grad_squared = all.loss->getSquareGrad(ec.pred.scalar, ld.label) * ld.weight;
     if (grad_squared == 0) return 1.;
     
-    norm_data nd = {grad_squared, 0., 0., {g.neg_power_t, g.neg_norm_power}};
+    norm_data nd = {grad_squared, 0., 0., {g.neg_power_t, g.neg_norm_power}, &all.reg};
     
-    foreach_feature<norm_data,pred_per_update_feature<sqrt_rate, feature_mask_off, adaptive, normalized, spare> >(all, ec, nd);
+    foreach_feature<norm_data,pred_per_update_feature<sqrt_rate, feature_mask_off, split, adaptive, normalized, spare> >(all, ec, nd);
     
     if(normalized) {
       g.all->normalized_sum_norm_x += ld.weight * nd.norm_x;
       g.total_weight += ld.weight;
 
-      g.update_multiplier = average_update<sqrt_rate, adaptive, normalized>(g, nd.pred_per_update);
-      nd.pred_per_update *= g.update_multiplier;
+      update_multiplier = average_update<sqrt_rate, adaptive, normalized>(g, nd.pred_per_update);
+      nd.pred_per_update *= update_multiplier;
     }
     
     return nd.pred_per_update;
   }
 
-  template<bool sparse_l2, bool invariant, bool sqrt_rate, bool feature_mask_off, size_t adaptive, size_t normalized, size_t spare>
-float compute_update(gd& g, example& ec)
+  template<bool sparse_l2, bool invariant, bool sqrt_rate, bool feature_mask_off, bool split, size_t adaptive, size_t normalized, size_t spare>
+float compute_update(gd& g, example& ec, float& update_multiplier)
 {//invariant: not a test label, importance weight > 0
   label_data& ld = ec.l.simple;
   vw& all = *g.all;
@@ -530,7 +647,7 @@ float compute_update(gd& g, example& ec)
     {
       float pred_per_update;
       if(adaptive || normalized)
-	pred_per_update = get_pred_per_update<sqrt_rate, feature_mask_off, adaptive, normalized, spare>(g,ec);
+	pred_per_update = get_pred_per_update<sqrt_rate, feature_mask_off, split, adaptive, normalized, spare>(g,ec,update_multiplier);
       else
 	pred_per_update = ec.total_sum_feat_sq;
       
@@ -565,18 +682,25 @@ float compute_update(gd& g, example& ec)
   return update;
 }
 
-  template<bool sparse_l2, bool invariant, bool sqrt_rate, bool feature_mask_off, size_t adaptive, size_t normalized, size_t spare>
+  inline void mark_row(regressor& reg, float, feature_index fi)
+  { reg.dirty_rows[(fi & reg.weight_mask) >> reg.stride_shift] = 1; }
+
+  template<bool sparse_l2, bool invariant, bool sqrt_rate, bool feature_mask_off, bool split, size_t adaptive, size_t normalized, size_t spare>
 void update(gd& g, base_learner& base, example& ec)
 {//invariant: not a test label, importance weight > 0
   float update;
-  if ( (update = compute_update<sparse_l2, invariant, sqrt_rate, feature_mask_off, adaptive, normalized, spare> (g, ec)) != 0.)
-    train<sqrt_rate, feature_mask_off, adaptive, normalized, spare>(g, ec, update);
+  float update_multiplier = 1.f; // kept off gd so learner threads do not share it
+  if ( (update = compute_update<sparse_l2, invariant, sqrt_rate, feature_mask_off, split, adaptive, normalized, spare> (g, ec, update_multiplier)) != 0.)
+    train<sqrt_rate, feature_mask_off, split, adaptive, normalized, spare>(g, ec, update, update_multiplier);
+  // the rows of the example, also the ones only the adaptive or normalized state of changed
+  if (g.all->reg.dirty_rows != nullptr)
+    foreach_feature<regressor, feature_index, mark_row>(*g.all, ec, g.all->reg);
   
   if (g.all->sd->contraction < 1e-10)  // updating weights now to avoid numerical instability
     sync_weights(*g.all);
 }
 
-  template<bool sparse_l2, bool invariant, bool sqrt_rate, bool feature_mask_off, size_t adaptive, size_t normalized, size_t spare>
+  template<bool sparse_l2, bool invariant, bool sqrt_rate, bool feature_mask_off, bool split, size_t adaptive, size_t normalized, size_t spare>
   void learn(gd& g, base_learner& base, example& ec)
   {//invariant: not a test label, importance weight > 0
   assert(ec.in_use);
@@ -584,36 +708,663 @@ void update(gd& g, base_learner& base, example& ec)
   assert(ec.l.simple.weight > 0.);
 
   g.predict(g,base,ec);
-  update<sparse_l2, invariant, sqrt_rate, feature_mask_off, adaptive, normalized, spare>(g,base,ec);
+  update<sparse_l2, invariant, sqrt_rate, feature_mask_off, split, adaptive, normalized, spare>(g,base,ec);
 }
 
+  // --minibatch B: the examples of a batch are predicted with the weights as
+  // they were at its start.  Their features and loss derivatives are kept,
+  // and after B examples the gradients are summed per weight and applied
+  // once through the same adaptive and normalized rules as the online
+  // update.  The online rule scales its step by pred_per_update and divides
+  // it out again, so even B = 1 only agrees with it up to rounding, which
+  // --sgd and --adaptive without --normalized can grow.  The summing is split over --minibatch_threads workers: worker t
+  // adds up the t-th slice of the batch into its own sparse tables, one per
+  // part of the weight vector, and then worker p merges the tables of part p
+  // in worker order and updates those weights.  Every sum is taken in the
+  // same order whatever the timing, so runs are repeatable.
+  struct batch_example {
+    size_t end; // of its features in minibatch::features
+    float grad; // derivative of the loss times the importance weight and, without adaptive, the power_t decay
+    float grad_squared; // the square gradient adaptive accumulates, times the importance weight
+    float weight;
+  };
+
+  struct batch_gradient {
+    uint64_t key; // weight index + 1, 0 for an empty slot
+    float grad; // sum of grad * x
+    float grad_squared; // sum of grad_squared * x^2
+    float norm; // sum of weight * x^2
+    float max_x; // largest |x|
+    float rate; // the learning rate of the weight, once the batch is applied
+  };
+
+  struct gradient_table {
+    batch_gradient* slots;
+    size_t mask; // number of slots - 1
+    size_t count;
+  };
+
+  enum batch_phase { SUM_GRADIENTS, UPDATE_RATES, APPLY_GRADIENTS, EXIT_BATCH_WORKERS };
+
+  struct batch_worker {
+    gd* g;
+    size_t id;
+#ifndef _WIN32
+    pthread_t thread;
+#else
+    HANDLE thread;
+#endif
+  };
+
+  struct minibatch {
+    size_t learned; // examples learned since the last batch was applied
+    v_array<feature> features; // of the kept examples, weight_index includes ft_offset
+    v_array<batch_example> examples;
+    size_t num_threads;
+    gradient_table* tables; // num_threads x num_threads, [worker][part]
+    double* norm_x; // per part, for the normalized update
+    float update_multiplier;
+
+    batch_worker* workers; // the num_threads - 1 helpers of the learner thread
+    MUTEX lock;
+    CV start;
+    CV done;
+    batch_phase phase;
+    size_t generation;
+    size_t running;
+  };
+
+  inline void keep_feature(minibatch& mb, float x, feature_index fi)
+  {
+    feature f = {x, fi};
+    mb.features.push_back(f);
+  }
+
+  void grow_table(gradient_table& t)
+  {
+    size_t old_size = t.slots == nullptr ? 0 : t.mask + 1;
+    batch_gradient* old_slots = t.slots;
+    size_t size = max(old_size * 2, (size_t)1 << 10);
+    t.slots = calloc_or_die<batch_gradient>(size);
+    t.mask = size - 1;
+    for (size_t i = 0; i < old_size; i++)
+      if (old_slots[i].key != 0)
+	{
+	  size_t j = (size_t)((old_slots[i].key * 0x9E3779B97F4A7C15ULL) >> 32) & t.mask;
+	  while (t.slots[j].key != 0)
+	    j = (j + 1) & t.mask;
+	  t.slots[j] = old_slots[i];
+	}
+    free(old_slots);
+  }
+
+  inline batch_gradient& find_gradient(gradient_table& t, feature_index index)
+  {
+    if (2 * (t.count + 1) > t.mask + 1)
+      grow_table(t);
+    uint64_t key = (uint64_t)index + 1;
+    size_t i = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & t.mask;
+    while (t.slots[i].key != key && t.slots[i].key != 0)
+      i = (i + 1) & t.mask;
+    if (t.slots[i].key == 0)
+      {
+	t.slots[i].key = key;
+	t.count++;
+      }
+    return t.slots[i];
+  }
+
+  inline size_t part_of(vw& all, feature_index index, size_t parts)
+  { return (index >> all.reg.stride_shift) % parts; }
+
+  void sum_gradients(gd& g, minibatch& mb, size_t worker)
+  {
+    vw& all = *g.all;
+    size_t n = mb.examples.size();
+    gradient_table* tables = mb.tables + worker * mb.num_threads;
+    for (size_t e = worker * n / mb.num_threads; e < (worker + 1) * n / mb.num_threads; e++)
+      {
+	batch_example& b = mb.examples[e];
+	feature* f = mb.features.begin + (e == 0 ? 0 : mb.examples[e-1].end);
+	for (; f != mb.features.begin + b.end; f++)
+	  {
+	    feature_index index = f->weight_index & (feature_index)all.reg.weight_mask;
+	    batch_gradient& s = find_gradient(tables[part_of(all, index, mb.num_threads)], index);
+	    float x2 = f->x * f->x;
+	    s.grad += b.grad * f->x;
+	    s.grad_squared += b.grad_squared * x2;
+	    s.norm += b.weight * x2;
+	    s.max_x = max(s.max_x, fabsf(f->x));
+	  }
+      }
+  }
+
+  // merges the tables of the part into the first worker's and brings the
+  // adaptive and normalized state of its weights up to date, as
+  // pred_per_update_feature does for one example
+  template<bool sqrt_rate, bool feature_mask_off, bool split, size_t adaptive, size_t normalized, size_t spare>
+  void update_rates(gd& g, minibatch& mb, size_t part)
+  {
+    vw& all = *g.all;
+    gradient_table& merged = mb.tables[part];
+    for (size_t worker = 1; worker < mb.num_threads; worker++)
+      {
+	gradient_table& t = mb.tables[worker * mb.num_threads + part];
+	if (t.count == 0)
+	  continue;
+	for (batch_gradient* s = t.slots; s != t.slots + t.mask + 1; s++)
+	  if (s->key != 0)
+	    {
+	      batch_gradient& m = find_gradient(merged, (feature_index)(s->key - 1));
+	      m.grad += s->grad;
+	      m.grad_squared += s->grad_squared;
+	      m.norm += s->norm;
+	      m.max_x = max(m.max_x, s->max_x);
+	    }
+	memset(t.slots, 0, (t.mask + 1) * sizeof(batch_gradient));
+	t.count = 0;
+      }
+
+    power_data pd = {g.neg_power_t, g.neg_norm_power};
+    double norm_x = 0.;
+    if (merged.count > 0)
+      for (batch_gradient* s = merged.slots; s != merged.slots + merged.mask + 1; s++)
+	if (s->key != 0)
+	  {
+	    float& fw = all.reg.weight_vector[s->key - 1];
+	    weight* w = state_of<split, spare>(all.reg, fw);
+	    if (!feature_mask_off && fw == 0.)
+	      {
+		s->rate = 0.;
+		continue;
+	      }
+	    if (adaptive)
+	      w[adaptive] += s->grad_squared;
+	    if (normalized)
+	      {
+		if (s->max_x > w[normalized])
+		  {
+		    if (w[normalized] > 0.)
+		      {
+			if (sqrt_rate)
+			  {
+			    float rescale = w[normalized]/s->max_x;
+			    fw *= (adaptive ? rescale : rescale*rescale);
+			  }
+			else
+			  {
+			    float rescale = s->max_x/w[normalized];
+			    fw *= powf(rescale*rescale, g.neg_norm_power);
+			  }
+		      }
+		    w[normalized] = s->max_x;
+		  }
+		norm_x += s->norm / (w[normalized] * w[normalized]);
+	      }
+	    s->rate = compute_rate_decay<sqrt_rate, adaptive, normalized>(pd, w);
+	  }
+    mb.norm_x[part] = norm_x;
+  }
+
+  template<bool sqrt_rate, size_t adaptive, size_t normalized>
+  float batch_multiplier(gd& g)
+  { return average_update<sqrt_rate, adaptive, normalized>(g, 0.f); }
+
+  void apply_gradients(gd& g, minibatch& mb, size_t part)
+  {
+    vw& all = *g.all;
+    gradient_table& t = mb.tables[part];
+    if (t.count == 0)
+      return;
+    float step = - all.eta * mb.update_multiplier;
+    for (batch_gradient* s = t.slots; s != t.slots + t.mask + 1; s++)
+      if (s->key != 0)
+	all.reg.weight_vector[s->key - 1] += step * s->rate * s->grad;
+    memset(t.slots, 0, (t.mask + 1) * sizeof(batch_gradient));
+    t.count = 0;
+  }
+
+  void run_batch_phase(gd& g, batch_phase phase, size_t id)
+  {
+    minibatch& mb = *g.batch;
+    switch (phase)
+      {
+      case SUM_GRADIENTS: sum_gradients(g, mb, id); break;
+      case UPDATE_RATES: g.update_rates(g, mb, id); break;
+      case APPLY_GRADIENTS: apply_gradients(g, mb, id); break;
+      default: break;
+      }
+  }
+
+#ifdef _WIN32
+  DWORD WINAPI batch_worker_loop(LPVOID in)
+#else
+  void *batch_worker_loop(void *in)
+#endif
+  {
+    batch_worker& w = *(batch_worker*)in;
+    minibatch& mb = *w.g->batch;
+    pin_thread(*w.g->all);
+    size_t seen = 0;
+    while (true)
+      {
+	mutex_lock(&mb.lock);
+	while (mb.generation == seen)
+	  condition_variable_wait(&mb.start, &mb.lock);
+	seen = mb.generation;
+	batch_phase phase = mb.phase;
+	mutex_unlock(&mb.lock);
+	if (phase == EXIT_BATCH_WORKERS)
+	  break;
+
+	run_batch_phase(*w.g, phase, w.id);
+
+	mutex_lock(&mb.lock);
+	if (--mb.running == 0)
+	  condition_variable_signal(&mb.done);
+	mutex_unlock(&mb.lock);
+      }
+#ifndef _WIN32
+    return nullptr;
+#else
+    return 0L;
+#endif
+  }
+
+  // runs a phase on every worker, the learner thread being worker 0
+  void run_batch_workers(gd& g, batch_phase phase)
+  {
+    minibatch& mb = *g.batch;
+    if (mb.num_threads == 1)
+      return run_batch_phase(g, phase, 0);
+
+    mutex_lock(&mb.lock);
+    mb.phase = phase;
+    mb.running = mb.num_threads - 1;
+    mb.generation++;
+    condition_variable_signal_all(&mb.start);
+    mutex_unlock(&mb.lock);
+
+    run_batch_phase(g, phase, 0);
+
+    mutex_lock(&mb.lock);
+    while (mb.running > 0)
+      condition_variable_wait(&mb.done, &mb.lock);
+    mutex_unlock(&mb.lock);
+  }
+
+  void apply_batch(gd& g)
+  {
+    minibatch& mb = *g.batch;
+    mb.learned = 0;
+    if (mb.examples.size() == 0)
+      return;
+
+    run_batch_workers(g, SUM_GRADIENTS);
+    run_batch_workers(g, UPDATE_RATES);
+    if (g.all->normalized_updates)
+      {
+	for (size_t part = 0; part < mb.num_threads; part++)
+	  g.all->normalized_sum_norm_x += mb.norm_x[part];
+	for (batch_example* b = mb.examples.begin; b != mb.examples.end; b++)
+	  g.total_weight += b->weight;
+      }
+    mb.update_multiplier = g.batch_multiplier(g);
+    run_batch_workers(g, APPLY_GRADIENTS);
+
+    mb.features.erase();
+    mb.examples.erase();
+  }
+
+  void learn_batch(gd& g, base_learner& base, example& ec)
+  {//invariant: not a test label, importance weight > 0
+    assert(ec.in_use);
+    assert(ec.l.simple.label != FLT_MAX);
+    assert(ec.l.simple.weight > 0.);
+    vw& all = *g.all;
+    minibatch& mb = *g.batch;
+    label_data& ld = ec.l.simple;
+
+    g.predict(g,base,ec);
+    ec.updated_prediction = ec.pred.scalar;
+    if (all.loss->getLoss(all.sd, ec.pred.scalar, ld.label) > 0.)
+      {
+	batch_example b;
+	b.grad = all.loss->first_derivative(all.sd, ec.pred.scalar, ld.label) * ld.weight;
+	if (!all.adaptive)
+	  b.grad *= powf((float)(ec.example_t - all.sd->weighted_holdout_examples), g.neg_power_t);
+	b.grad_squared = all.loss->getSquareGrad(ec.pred.scalar, ld.label) * ld.weight;
+	b.weight = ld.weight;
+	foreach_feature<minibatch, feature_index, keep_feature>(all, ec, mb);
+	b.end = mb.features.size();
+	mb.examples.push_back(b);
+      }
+    if (++mb.learned == g.batch_size)
+      apply_batch(g);
+  }
+
+  void init_minibatch(gd& g, size_t num_threads)
+  {
+    minibatch& mb = calloc_or_die<minibatch>();
+    g.batch = &mb;
+    mb.num_threads = num_threads;
+    mb.tables = calloc_or_die<gradient_table>(num_threads * num_threads);
+    mb.norm_x = calloc_or_die<double>(num_threads);
+    if (num_threads == 1)
+      return;
+
+    initialize_mutex(&mb.lock);
+    initialize_condition_variable(&mb.start);
+    initialize_condition_variable(&mb.done);
+    mb.workers = calloc_or_die<batch_worker>(num_threads - 1);
+    for (size_t i = 0; i < num_threads - 1; i++)
+      {
+	batch_worker& w = mb.workers[i];
+	w.g = &g;
+	w.id = i + 1;
+#ifndef _WIN32
+	pthread_create(&w.thread, nullptr, batch_worker_loop, &w);
+#else
+	w.thread = ::CreateThread(nullptr, 0, static_cast<LPTHREAD_START_ROUTINE>(batch_worker_loop), &w, 0L, nullptr);
+#endif
+      }
+  }
+
+  void finish_minibatch(gd& g)
+  {
+    minibatch& mb = *g.batch;
+    if (mb.num_threads > 1)
+      {
+	mutex_lock(&mb.lock);
+	mb.phase = EXIT_BATCH_WORKERS;
+	mb.generation++;
+	condition_variable_signal_all(&mb.start);
+	mutex_unlock(&mb.lock);
+	for (size_t i = 0; i < mb.num_threads - 1; i++)
+	  {
+#ifndef _WIN32
+	    pthread_join(mb.workers[i].thread, nullptr);
+#else
+	    ::WaitForSingleObject(mb.workers[i].thread, INFINITE);
+	    ::CloseHandle(mb.workers[i].thread);
+#endif
+	  }
+	free(mb.workers);
+	delete_mutex(&mb.lock);
+      }
+    for (size_t i = 0; i < mb.num_threads * mb.num_threads; i++)
+      free(mb.tables[i].slots);
+    free(mb.tables);
+    free(mb.norm_x);
+    mb.features.delete_v();
+    mb.examples.delete_v();
+    free(&mb);
+  }
+
 void sync_weights(vw& all) {
   if (all.sd->gravity == 0. && all.sd->contraction == 1.)  // to avoid unnecessary weight synchronization
     return;
-  uint32_t length = 1 << all.num_bits;
+  size_t length = all.length();
   size_t stride = 1 << all.reg.stride_shift;
-  for(uint32_t i = 0; i < length && all.reg_mode; i++)
-    all.reg.weight_vector[stride*i] = trunc_weight(all.reg.weight_vector[stride*i], (float)all.sd->gravity) * (float)all.sd->contraction;
+  if (all.reg.sparse != nullptr)
+    { // the rows not in the table are the initial one
+      sparse_weights& s = *all.reg.sparse;
+      for (size_t e = 0; e < sparse_entries(s) && all.reg_mode; e++)
+	if (weight* w = entry_row(s, e))
+	  *w = trunc_weight(*w, (float)all.sd->gravity) * (float)all.sd->contraction;
+      if (all.reg_mode)
+	*s.initial = trunc_weight(*s.initial, (float)all.sd->gravity) * (float)all.sd->contraction;
+    }
+  else
+    for(size_t i = 0; i < length && all.reg_mode; i++)
+      all.reg.weight_vector[stride*i] = trunc_weight(all.reg.weight_vector[stride*i], (float)all.sd->gravity) * (float)all.sd->contraction;
+  if (all.reg_mode && all.reg.dirty_rows != nullptr)
+    memset(all.reg.dirty_rows, 1, length);
   all.sd->gravity = 0.;
   all.sd->contraction = 1.;
 }
 
+// The row of a weight in a model file takes 4 bytes, or 8 when -b is over 32.
+static void write_index(vw& all, io_buf& model_file, uint64_t i, bool text)
+{
+  char buff[512];
+  int text_len = sprintf(buff, "%llu", (unsigned long long)i);
+  if (all.num_bits > 32)
+    bin_text_write_fixed(model_file,(char *)&i, sizeof (i),
+			 buff, text_len, text);
+  else
+    {
+      uint32_t narrow = (uint32_t)i;
+      bin_text_write_fixed(model_file,(char *)&narrow, sizeof (narrow),
+			   buff, text_len, text);
+    }
+}
+
+static size_t read_index(vw& all, io_buf& model_file, uint64_t& i)
+{
+  if (all.num_bits > 32)
+    return bin_read_fixed(model_file, (char*)&i, sizeof(i),"");
+  uint32_t narrow = 0;
+  size_t brw = bin_read_fixed(model_file, (char*)&narrow, sizeof(narrow),"");
+  i = narrow;
+  return brw;
+}
+
+static int model_layout(vw& all, bool read)
+{
+  if (read)
+    return all.loaded_layout;
+  return all.mmap_model ? WEIGHTS_MAPPABLE : (all.chunked_model ? WEIGHTS_CHUNKED : WEIGHTS_AS_PAIRS);
+}
+
+// With --mmap_model the weights are written as a header, zeros up to a
+// multiple of dense_alignment in the file and then every weight, or with
+// --save_resume every row of stride floats as gd keeps it in memory, the
+// weight followed by its state.  Loading maps them in place when the layout
+// in memory is the same, as for -t (which keeps no state) of a model saved
+// without --save_resume, and reads them otherwise.
+const size_t dense_alignment = (size_t)1 << 16; // a multiple of the page size, also on 64k page systems
+const size_t dense_chunk = (size_t)1 << 12; // floats copied at once
+
+// the offset in the file of the next byte of model_file, -1 if it has none
+static int64_t model_position(io_buf& model_file, bool read)
+{
+  if (model_file.files.size() != 1 || model_file.compressed())
+    return -1;
+#ifdef _WIN32
+  int64_t pos = _lseeki64(model_file.files[0], 0, SEEK_CUR);
+#else
+  int64_t pos = lseek(model_file.files[0], 0, SEEK_CUR);
+#endif
+  if (pos < 0)
+    return -1;
+  return read ? pos - (model_file.endloaded - model_file.space.end) : pos + model_file.space.size();
+}
+
+static void skip_model_bytes(io_buf& model_file, size_t bytes)
+{
+  size_t buffered = min(bytes, (size_t)(model_file.endloaded - model_file.space.end));
+  model_file.space.end += buffered;
+#ifdef _WIN32
+  _lseeki64(model_file.files[0], bytes - buffered, SEEK_CUR);
+#else
+  lseek(model_file.files[0], bytes - buffered, SEEK_CUR);
+#endif
+}
+
+static weight& dense_column(vw& all, uint64_t i, size_t k)
+{
+  if (all.reg.state_stride > 0)
+    return k == 0 ? all.reg.weight_vector[i] : all.reg.state_vector[i*all.reg.state_stride + k];
+  return all.reg.weight_vector[(i << all.reg.stride_shift) + k];
+}
+
+static void save_load_dense(vw& all, io_buf& model_file, bool read, bool resume)
+{
+  uint64_t rows = all.length();
+  uint32_t memory_stride = all.reg.state_stride > 0 ? (uint32_t)all.reg.state_stride : 1 << all.reg.stride_shift;
+  uint32_t stride = resume ? memory_stride : 1;
+  uint32_t padding = 0;
+  if (!read)
+    {
+      int64_t pos = model_position(model_file, false);
+      size_t header = sizeof(rows) + sizeof(stride) + sizeof(padding);
+      if (pos >= 0)
+	padding = (uint32_t)((dense_alignment - (pos + header) % dense_alignment) % dense_alignment);
+    }
+  bin_text_read_write_fixed(model_file, (char*)&rows, sizeof(rows), "", read, "", 0, false);
+  bin_text_read_write_fixed(model_file, (char*)&stride, sizeof(stride), "", read, "", 0, false);
+  bin_text_read_write_fixed(model_file, (char*)&padding, sizeof(padding), "", read, "", 0, false);
+  if (read && (rows != all.length() || stride == 0 || padding >= dense_alignment))
+    {
+      cerr << "error: the weights of the model do not match its header, bad model format" << endl;
+      throw exception();
+    }
+
+  weight chunk[dense_chunk];
+  memset(chunk, 0, min((size_t)padding, sizeof(chunk)));
+  for (size_t left = padding; left > 0;)
+    {
+      size_t n = min(left, sizeof(chunk));
+      if (read)
+	bin_read_fixed(model_file, (char*)chunk, n, "");
+      else
+	bin_write_fixed(model_file, (char*)chunk, (uint32_t)n);
+      left -= n;
+    }
+
+  size_t rows_per_chunk = max(dense_chunk / stride, (size_t)1);
+  if (stride > dense_chunk)
+    {
+      cerr << "error: rows of " << stride << " weights are too long for --mmap_model" << endl;
+      throw exception();
+    }
+
+  if (read)
+    {
+      // learning from a model saved without its state needs the state
+      // set up as usual, so that is read below
+      int64_t pos = model_position(model_file, true);
+      if (pos >= 0 && pos % dense_alignment == 0 && stride == memory_stride && all.reg.state_stride == 0
+	  && all.reg.weight_vector != nullptr && all.reg.quantized == nullptr && all.reg.sparse == nullptr
+	  && all.huge_pages == HUGE_PAGES_OFF && all.numa_node == numa_default
+	  && !all.vm.count("feature_mask") && (resume || !all.training))
+	{
+	  size_t mapped_bytes;
+	  weight* w = map_weights(model_file.files[0], (size_t)pos, rows * stride, all.training, mapped_bytes);
+	  if (w != nullptr)
+	    {
+	      free_weights(all);
+	      all.reg.weight_vector = w;
+	      all.weight_bytes_mapped = mapped_bytes;
+	      skip_model_bytes(model_file, mapped_bytes);
+	      return;
+	    }
+	}
+
+      // zero weights are left as they were set up, like the rows a model
+      // file without --mmap_model leaves out
+      size_t columns = resume && all.training ? min(stride, memory_stride) : 1;
+      for (uint64_t i = 0; i < rows; i += rows_per_chunk)
+	{
+	  size_t n = (size_t)min((uint64_t)rows_per_chunk, rows - i);
+	  if (bin_read_fixed(model_file, (char*)chunk, n * stride * sizeof(weight), "") < n * stride * sizeof(weight))
+	    {
+	      cerr << "error: the model file ends in its weights, bad model format" << endl;
+	      throw exception();
+	    }
+	  for (size_t j = 0; j < n; j++)
+	    {
+	      weight* row = chunk + j * stride;
+	      if (row[0] == 0.)
+		continue;
+	      if (all.reg.quantized != nullptr)
+		set_quantized(*all.reg.quantized, (i + j) << all.reg.stride_shift, row[0]);
+	      if (all.reg.weight_vector != nullptr)
+		for (size_t k = 0; k < columns; k++)
+		  dense_column(all, i + j, k) = row[k];
+	    }
+	}
+    }
+  else
+    for (uint64_t i = 0; i < rows; i += rows_per_chunk)
+      {
+	size_t n = (size_t)min((uint64_t)rows_per_chunk, rows - i);
+	for (size_t j = 0; j < n; j++)
+	  for (size_t k = 0; k < stride; k++)
+	    chunk[j * stride + k] = dense_column(all, i + j, k);
+	bin_write_fixed(model_file, (char*)chunk, (uint32_t)(n * stride * sizeof(weight)));
+      }
+}
+
+// the rows of save_load_dense, for --chunked_model
+struct chunked_weights {
+  vw* all;
+  uint32_t columns; // set when loading
+};
+
+static bool get_chunked_row(void* data, uint64_t i, weight* row)
+{
+  chunked_weights& c = *(chunked_weights*)data;
+  for (size_t k = 0; k < c.columns; k++)
+    row[k] = dense_column(*c.all, i, k);
+  return row[0] != 0.;
+}
+
+static void set_chunked_row(void* data, uint64_t i, const weight* row, uint32_t stride)
+{
+  chunked_weights& c = *(chunked_weights*)data;
+  vw& all = *c.all;
+  if (all.reg.quantized != nullptr)
+    set_quantized(*all.reg.quantized, i << all.reg.stride_shift, row[0]);
+  if (all.reg.weight_vector != nullptr)
+    for (size_t k = 0; k < min(stride, c.columns); k++)
+      dense_column(all, i, k) = row[k];
+}
+
+static void save_load_chunked_weights(vw& all, io_buf& model_file, bool read, bool resume)
+{
+  uint32_t memory_stride = all.reg.state_stride > 0 ? (uint32_t)all.reg.state_stride : 1 << all.reg.stride_shift;
+  chunked_weights c = {&all, resume ? memory_stride : 1};
+  if (read && !(resume && all.training))
+    c.columns = 1;
+  chunked_rows r = {all.length(), resume ? memory_stride : 1, &c, get_chunked_row, set_chunked_row,
+		    all.reg.quantized != nullptr};
+  save_load_chunked(all, model_file, read, r);
+}
+
+static void write_weight(vw& all, io_buf& model_file, uint64_t i, weight* v, bool text)
+{
+  if (*v != 0.)
+    {
+      char buff[512];
+      int text_len;
+
+      write_index(all, model_file, i, text);
+
+      text_len = sprintf(buff, ":%f\n", *v);
+      bin_text_write_fixed(model_file,(char *)v, sizeof (*v),
+			   buff, text_len, text);
+    }
+}
+
 void save_load_regressor(vw& all, io_buf& model_file, bool read, bool text)
 {
-  uint32_t length = 1 << all.num_bits;
+  uint64_t length = all.length();
   uint32_t stride = 1 << all.reg.stride_shift;
-  int c = 0;
-  uint32_t i = 0;
+  uint64_t i = 0;
   size_t brw = 1;
 
   if(all.print_invert){ //write readable model with feature names           
     weight* v;
+    weight w;
     char buff[512];
     int text_len; 
     typedef std::map< std::string, size_t> str_int_map;  
         
     for(str_int_map::iterator it = all.name_index_map.begin(); it != all.name_index_map.end(); ++it){              
-      v = &(all.reg.weight_vector[stride*(it->second)]);
+      w = read_weight(all.reg, stride*(it->second));
+      v = &w;
       if(*v != 0.){
         text_len = sprintf(buff, "%s", (char*)it->first.c_str());
         brw = bin_text_write_fixed(model_file, (char*)it->first.c_str(), sizeof(*it->first.c_str()),
@@ -626,40 +1377,49 @@ void save_load_regressor(vw& all, io_buf& model_file, bool read, bool text)
     return;
   } 
 
+  if (model_layout(all, read) == WEIGHTS_MAPPABLE && !text)
+    {
+      save_load_dense(all, model_file, read, false);
+      return;
+    }
+  if (model_layout(all, read) == WEIGHTS_CHUNKED && !text)
+    {
+      save_load_chunked_weights(all, model_file, read, false);
+      return;
+    }
+
+  if (!read && all.reg.sparse != nullptr)
+    { // the rows of the table, in the order the loop below writes them
+      v_array<uint64_t> rows = v_init<uint64_t>();
+      sorted_rows(*all.reg.sparse, rows);
+      for (uint64_t* r = rows.begin; r != rows.end; r++)
+	write_weight(all, model_file, *r, find_row(*all.reg.sparse, *r), text);
+      rows.delete_v();
+      return;
+    }
+
   do 
     {
       brw = 1;
       weight* v;
       if (read)
 	{
-	  c++;
-	  brw = bin_read_fixed(model_file, (char*)&i, sizeof(i),"");
+	  brw = read_index(all, model_file, i);
 	  if (brw > 0)
 	    {
 	      assert (i< length);		
-	      v = &(all.reg.weight_vector[stride*i]);
+	      weight w;
+	      if (all.reg.sparse != nullptr)
+		v = &sparse_weight(*all.reg.sparse, stride*i, true);
+	      else
+		v = all.reg.weight_vector != nullptr ? &(all.reg.weight_vector[stride*i]) : &w;
 	      brw += bin_read_fixed(model_file, (char*)v, sizeof(*v), "");
+	      if (all.reg.quantized != nullptr)
+		set_quantized(*all.reg.quantized, stride*i, *v);
 	    }
 	}
       else// write binary or text
-	{
-                      
-         v = &(all.reg.weight_vector[stride*i]);
-	 if (*v != 0.)
-	    {
-	      c++;
-	      char buff[512];
-	      int text_len;
-
-	      text_len = sprintf(buff, "%d", i);
-	      brw = bin_text_write_fixed(model_file,(char *)&i, sizeof (i),
-					 buff, text_len, text);
-	      
-              text_len = sprintf(buff, ":%f\n", *v);
-	      brw+= bin_text_write_fixed(model_file,(char *)v, sizeof (*v),
-					 buff, text_len, text);
-	    }
-	}
+	write_weight(all, model_file, i, &(all.reg.weight_vector[stride*i]), text);
  
       if (!read)
 	i++;
@@ -667,11 +1427,33 @@ void save_load_regressor(vw& all, io_buf& model_file, bool read, bool text)
   while ((!read && i < length) || (read && brw >0));  
 }
 
-//void save_load_online_state(gd& g, io_buf& model_file, bool read, bool text)
-void save_load_online_state(vw& all, io_buf& model_file, bool read, bool text, gd* g)
+// a weight and the state after it, as save_load_online_state writes them
+static void write_state(vw& all, io_buf& model_file, uint64_t i, weight* v, uint32_t stride, bool text)
+{
+  if (*v != 0.)
+    {
+      char buff[512];
+      int text_len;
+      write_index(all, model_file, i, text);
+
+      if (stride == 2)
+	{//either adaptive or normalized
+	  text_len = sprintf(buff, ":%f %f\n", *v, *(v+1));
+	  bin_text_write_fixed(model_file,(char *)v, 2*sizeof (*v),
+			       buff, text_len, text);
+	}
+      else
+	{//adaptive and normalized
+	  text_len = sprintf(buff, ":%f %f %f\n", *v, *(v+1), *(v+2));
+	  bin_text_write_fixed(model_file,(char *)v, 3*sizeof (*v),
+			       buff, text_len, text);
+	}
+    }
+}
+
+// the learning statistics --save_resume keeps ahead of the weights
+static void save_load_online_stats(vw& all, io_buf& model_file, bool read, bool text, gd* g)
 {
-  //vw& all = *g.all;
-  
   char buff[512];
   
   uint32_t text_len = sprintf(buff, "initial_t %f\n", all.initial_t);
@@ -775,56 +1557,96 @@ void save_load_online_state(vw& all, io_buf& model_file, bool read, bool text, g
       all.sd->example_number = 0;
       all.sd->total_features = 0;
     }
+}
+
+//void save_load_online_state(gd& g, io_buf& model_file, bool read, bool text)
+void save_load_online_state(vw& all, io_buf& model_file, bool read, bool text, gd* g)
+{
+  //vw& all = *g.all;
+
+  save_load_online_stats(all, model_file, read, text, g);
   
-  uint32_t length = 1 << all.num_bits;
+  uint64_t length = all.length();
   uint32_t stride = 1 << all.reg.stride_shift;
-  int c = 0;
-  uint32_t i = 0;
+  // the file holds each weight followed by its state as they are
+  // interleaved in memory, also when --split_weights keeps them apart
+  uint32_t state_stride = all.reg.state_stride;
+  weight row[3];
+  uint64_t i = 0;
   size_t brw = 1;
+
+  if (model_layout(all, read) == WEIGHTS_MAPPABLE && !text)
+    {
+      save_load_dense(all, model_file, read, true);
+      return;
+    }
+  if (model_layout(all, read) == WEIGHTS_CHUNKED && !text)
+    {
+      save_load_chunked_weights(all, model_file, read, true);
+      return;
+    }
+
+  if (!read && all.reg.sparse != nullptr)
+    {
+      sparse_weights& s = *all.reg.sparse;
+      v_array<uint64_t> rows = v_init<uint64_t>();
+      sorted_rows(s, rows);
+      for (uint64_t* r = rows.begin; r != rows.end; r++)
+	{ // a row of one float is written as three, like the dense one
+	  weight* w = find_row(s, *r);
+	  for (size_t k = 0; k < 3; k++)
+	    row[k] = k < s.stride ? w[k] : 0.f;
+	  write_state(all, model_file, *r, row, stride, text);
+	}
+      rows.delete_v();
+      return;
+    }
+
   do 
     {
       brw = 1;
       weight* v; 
       if (read)
 	{
-	  c++;
-	  brw = bin_read_fixed(model_file, (char*)&i, sizeof(i),"");
+	  brw = read_index(all, model_file, i);
 	  if (brw > 0)
 	    {
 	      assert (i< length);		
-	      v = &(all.reg.weight_vector[stride*i]);
+	      v = state_stride > 0 || all.reg.weight_vector == nullptr ? row : &(all.reg.weight_vector[stride*i]);
 	      if (stride == 2) //either adaptive or normalized
 		brw += bin_read_fixed(model_file, (char*)v, sizeof(*v)*2, "");
 	      else //adaptive and normalized
 		brw += bin_read_fixed(model_file, (char*)v, sizeof(*v)*3, "");	
 	      if (!all.training)
 		v[1]=v[2]=0.;
+	      if (all.reg.quantized != nullptr)
+		set_quantized(*all.reg.quantized, stride*i, v[0]);
+	      if (state_stride > 0)
+		{
+		  all.reg.weight_vector[i] = row[0];
+		  all.reg.state_vector[i*state_stride + 1] = row[1];
+		  all.reg.state_vector[i*state_stride + 2] = row[2];
+		}
+	      if (all.reg.sparse != nullptr)
+		{
+		  weight* w = get_row(*all.reg.sparse, i);
+		  for (size_t k = 0; k < min((size_t)stride, (size_t)3); k++)
+		    w[k] = row[k];
+		}
 	    }
 	}
       else // write binary or text
 	{
-	  v = &(all.reg.weight_vector[stride*i]);
-	  if (*v != 0.)
+	  if (state_stride > 0)
 	    {
-	      c++;
-	      char buff[512];
-	      int text_len = sprintf(buff, "%d", i);
-	      brw = bin_text_write_fixed(model_file,(char *)&i, sizeof (i),
-					 buff, text_len, text);
-	      
-	      if (stride == 2)
-		{//either adaptive or normalized
-		  text_len = sprintf(buff, ":%f %f\n", *v, *(v+1));
-		  brw+= bin_text_write_fixed(model_file,(char *)v, 2*sizeof (*v),
-					     buff, text_len, text);
-		}
-	      else
-		{//adaptive and normalized
-		  text_len = sprintf(buff, ":%f %f %f\n", *v, *(v+1), *(v+2));
-		  brw+= bin_text_write_fixed(model_file,(char *)v, 3*sizeof (*v),
-					     buff, text_len, text);
-		}
+	      v = row;
+	      row[0] = all.reg.weight_vector[i];
+	      row[1] = all.reg.state_vector[i*state_stride + 1];
+	      row[2] = all.reg.state_vector[i*state_stride + 2];
 	    }
+	  else
+	    v = &(all.reg.weight_vector[stride*i]);
+	  write_state(all, model_file, i, v, stride, text);
 	}
       if (!read)
 	i++;
@@ -832,28 +1654,172 @@ void save_load_online_state(vw& all, io_buf& model_file, bool read, bool text, g
   while ((!read && i < length) || (read && brw >0));  
 }
 
+// A delta checkpoint (see save_checkpoint) holds its number in the chain,
+// the id of the whole model it is on, the bits, the floats of a row and
+// whether they include the state of --save_resume, that option's
+// statistics and then the rows learned since the checkpoint before it,
+// each as its row number and all of its floats, zero or not.
+const uint64_t delta_magic = 0x61746c6564207776ULL; // "vw delta"
+const uint32_t max_delta_stride = 3; // the weight, adaptive and normalized, as save_load_online_state keeps
+
+static void save_delta(gd& g, io_buf& model_file)
+{
+  vw& all = *g.all;
+  uint64_t magic = delta_magic;
+  uint32_t number = all.delta_number;
+  uint64_t base = all.sd->checkpoint_base;
+  uint32_t bits = all.num_bits;
+  bool resume = all.save_resume;
+  uint32_t memory_stride = all.reg.state_stride > 0 ? (uint32_t)all.reg.state_stride : 1 << all.reg.stride_shift;
+  uint32_t stride = resume ? min(memory_stride, max_delta_stride) : 1;
+  bin_write_fixed(model_file, (char*)&magic, sizeof(magic));
+  bin_write_fixed(model_file, (char*)&number, sizeof(number));
+  bin_write_fixed(model_file, (char*)&base, sizeof(base));
+  bin_write_fixed(model_file, (char*)&bits, sizeof(bits));
+  bin_write_fixed(model_file, (char*)&stride, sizeof(stride));
+  bin_write_fixed(model_file, (char*)&resume, sizeof(resume));
+  if (resume)
+    save_load_online_stats(all, model_file, false, false, &g);
+
+  unsigned char* dirty = all.reg.dirty_rows;
+  uint64_t length = all.length();
+  weight row[max_delta_stride];
+  for (uint64_t i = 0; i < length; i += sizeof(uint64_t))
+    if (*(uint64_t*)(dirty + i) != 0)
+      for (uint64_t j = i; j < min(i + sizeof(uint64_t), length); j++)
+	if (dirty[j])
+	  { // cleared first, so a row learned while it is written goes in the next delta too
+	    dirty[j] = 0;
+	    for (size_t k = 0; k < stride; k++)
+	      row[k] = dense_column(all, j, k);
+	    write_index(all, model_file, j, false);
+	    bin_write_fixed(model_file, (char*)row, stride * sizeof(weight));
+	  }
+}
+
+// applies all.model_name.delta.1, .2 and so on, as long as they are there
+// and were saved on this model
+static void load_delta_checkpoints(gd& g)
+{
+  vw& all = *g.all;
+  for (uint32_t number = 1; ; number++)
+    {
+      string name = delta_checkpoint_name(all.model_name, number);
+      ifstream probe(name.c_str());
+      if (!probe.is_open())
+	return;
+      probe.close();
+
+      io_buf delta;
+      delta.open_file(name.c_str(), false, io_buf::READ);
+      uint64_t magic = 0, base = 0;
+      uint32_t file_number = 0, bits = 0, stride = 0;
+      bool resume = false;
+      size_t brw = bin_read_fixed(delta, (char*)&magic, sizeof(magic), "");
+      brw += bin_read_fixed(delta, (char*)&file_number, sizeof(file_number), "");
+      brw += bin_read_fixed(delta, (char*)&base, sizeof(base), "");
+      brw += bin_read_fixed(delta, (char*)&bits, sizeof(bits), "");
+      brw += bin_read_fixed(delta, (char*)&stride, sizeof(stride), "");
+      brw += bin_read_fixed(delta, (char*)&resume, sizeof(resume), "");
+      if (brw < 2 * sizeof(uint64_t) + 3 * sizeof(uint32_t) + sizeof(resume) || magic != delta_magic
+	  || file_number != number || bits != all.num_bits || stride == 0 || stride > max_delta_stride)
+	{
+	  cerr << "error: " << name << " is not delta checkpoint " << number << " of " << all.model_name << endl;
+	  throw exception();
+	}
+      if (base != all.checkpoint_base)
+	{ // left by an older chain, if saving the model stopped before removing it
+	  cerr << "warning: ignoring " << name << " and the deltas after it, they were saved on another " << all.model_name << endl;
+	  delta.close_file();
+	  return;
+	}
+      if (all.loaded_layout == WEIGHTS_MAPPABLE)
+	{
+	  cerr << "error: " << name << " can not be applied to the weights mapped by --mmap_model" << endl;
+	  throw exception();
+	}
+      if (resume)
+	save_load_online_stats(all, delta, true, false, &g);
+
+      uint32_t memory_stride = all.reg.state_stride > 0 ? (uint32_t)all.reg.state_stride : 1 << all.reg.stride_shift;
+      size_t columns = resume && all.training ? min(stride, memory_stride) : 1;
+      weight row[max_delta_stride];
+      uint64_t i;
+      while (read_index(all, delta, i) > 0)
+	{
+	  if (i >= all.length() || bin_read_fixed(delta, (char*)row, stride * sizeof(weight), "") < stride * sizeof(weight))
+	    {
+	      cerr << "error: " << name << " is cut short in a row or holds one past the weights, bad model format" << endl;
+	      throw exception();
+	    }
+	  if (all.reg.quantized != nullptr)
+	    set_quantized(*all.reg.quantized, i << all.reg.stride_shift, row[0]);
+	  if (all.reg.sparse != nullptr)
+	    {
+	      weight* w = get_row(*all.reg.sparse, i);
+	      for (size_t k = 0; k < min(columns, all.reg.sparse->stride); k++)
+		w[k] = row[k];
+	    }
+	  else if (all.reg.weight_vector != nullptr)
+	    for (size_t k = 0; k < columns; k++)
+	      dense_column(all, i, k) = row[k];
+	}
+      delta.close_file();
+    }
+}
+
 void save_load(gd& g, io_buf& model_file, bool read, bool text)
 {
   vw& all = *g.all;
+  if (!read && g.batch != nullptr) // a save example or --save_per_pass mid batch
+    apply_batch(g);
+  if (!read && all.delta_number > 0)
+    {
+      save_delta(g, model_file);
+      return;
+    }
   if(read)
     {
-      initialize_regressor(all);
+      if (g.sparse)
+	init_sparse_weights(all);
+      else if (g.quantize == QUANTIZE_OFF || g.quantize_report)
+	initialize_regressor(all);
+      else
+	all.reg.weight_mask = (all.length() << all.reg.stride_shift) - 1;
+      if (g.quantize != QUANTIZE_OFF)
+	init_quantized(all, g.quantize, g.quantize_report);
+      if (g.delta_checkpoints && all.training && all.reg.dirty_rows == nullptr) // a byte per row, whole words of them
+	all.reg.dirty_rows = (unsigned char*)allocate_weights(all, ((all.length() + 7) & ~(size_t)7) / sizeof(weight), false, all.dirty_bytes_mapped);
 
       if(all.adaptive && all.initial_t > 0)
 	{
-	  uint32_t length = 1 << all.num_bits;
+	  size_t length = all.length();
 	  uint32_t stride = 1 << all.reg.stride_shift;
-	  for (size_t j = 1; j < stride*length; j+=stride)
+	  weight* state = all.reg.weight_vector;
+	  if (all.reg.state_stride > 0)
 	    {
-	      all.reg.weight_vector[j] = all.initial_t;   //for adaptive update, we interpret initial_t as previously seeing initial_t fake datapoints, all with squared gradient=1
-	      //NOTE: this is not invariant to the scaling of the data (i.e. when combined with normalized). Since scaling the data scales the gradient, this should ideally be 
-	      //feature_range*initial_t, or something like that. We could potentially fix this by just adding this base quantity times the current range to the sum of gradients 
-	      //stored in memory at each update, and always start sum of gradients to 0, at the price of additional additions and multiplications during the update...
+	      stride = all.reg.state_stride;
+	      state = all.reg.state_vector;
 	    }
+	  if (all.reg.sparse != nullptr) // the rows start as the initial one
+	    all.reg.sparse->initial[1] = all.initial_t;
+	  else
+	    for (size_t j = 1; j < stride*length; j+=stride)
+	      {
+	        state[j] = all.initial_t;   //for adaptive update, we interpret initial_t as previously seeing initial_t fake datapoints, all with squared gradient=1
+	        //NOTE: this is not invariant to the scaling of the data (i.e. when combined with normalized). Since scaling the data scales the gradient, this should ideally be 
+	        //feature_range*initial_t, or something like that. We could potentially fix this by just adding this base quantity times the current range to the sum of gradients 
+	        //stored in memory at each update, and always start sum of gradients to 0, at the price of additional additions and multiplications during the update...
+	      }
 	}
       
       if (g.initial_constant != 0.0)
-        VW::set_weight(all, constant, 0, g.initial_constant);
+	{
+	  if (all.reg.weight_vector != nullptr || all.reg.sparse != nullptr)
+	    VW::set_weight(all, constant, 0, g.initial_constant);
+	  if (all.reg.quantized != nullptr)
+	    set_quantized(*all.reg.quantized, (constant << all.reg.stride_shift) & all.reg.weight_mask, g.initial_constant);
+	}
     }
 
   if (model_file.files.size() > 0)
@@ -873,62 +1839,74 @@ void save_load(gd& g, io_buf& model_file, bool read, bool text)
       }
       else
 	save_load_regressor(all, model_file, read, text);
+      if (read && all.model_name != "")
+	load_delta_checkpoints(g);
     }
+  if (read && all.reg.quantized != nullptr)
+    finish_loading_quantized(*all.reg.quantized);
+}
+
+template<bool sparse_l2, bool invariant, bool sqrt_rate, bool feature_mask_off, bool split, uint32_t adaptive, uint32_t normalized, uint32_t spare, uint32_t next>
+uint32_t set_learn(gd& g)
+{
+  g.learn = learn<sparse_l2, invariant, sqrt_rate, feature_mask_off, split, adaptive, normalized, spare>;
+  g.update = update<sparse_l2, invariant, sqrt_rate, feature_mask_off, split, adaptive, normalized, spare>;
+  g.update_rates = update_rates<sqrt_rate, feature_mask_off, split, adaptive, normalized, spare>;
+  g.batch_multiplier = batch_multiplier<sqrt_rate, adaptive, normalized>;
+  return next;
 }
 
 template<bool sparse_l2, bool invariant, bool sqrt_rate, uint32_t adaptive, uint32_t normalized, uint32_t spare, uint32_t next>
-uint32_t set_learn(vw& all, bool feature_mask_off, gd& g)
+uint32_t set_learn(vw& all, bool feature_mask_off, bool split, gd& g)
 {
   all.normalized_idx = normalized;
   if (feature_mask_off)
-    {
-      g.learn = learn<sparse_l2, invariant, sqrt_rate, true, adaptive, normalized, spare>;
-      g.update = update<sparse_l2, invariant, sqrt_rate, true, adaptive, normalized, spare>;
-      return next;
-    }
+    if (split)
+      return set_learn<sparse_l2, invariant, sqrt_rate, true, true, adaptive, normalized, spare, next>(g);
+    else
+      return set_learn<sparse_l2, invariant, sqrt_rate, true, false, adaptive, normalized, spare, next>(g);
   else
-    {
-      g.learn = learn<sparse_l2, invariant, sqrt_rate, false, adaptive, normalized, spare>;
-      g.update = update<sparse_l2, invariant, sqrt_rate, false, adaptive, normalized, spare>;
-      return next;
-    }
+    if (split)
+      return set_learn<sparse_l2, invariant, sqrt_rate, false, true, adaptive, normalized, spare, next>(g);
+    else
+      return set_learn<sparse_l2, invariant, sqrt_rate, false, false, adaptive, normalized, spare, next>(g);
 }
 
 template<bool invariant, bool sqrt_rate, uint32_t adaptive, uint32_t normalized, uint32_t spare, uint32_t next>
-uint32_t set_learn(vw& all, bool feature_mask_off, gd& g)
+uint32_t set_learn(vw& all, bool feature_mask_off, bool split, gd& g)
 {
   if (g.sparse_l2 > 0.f)
-    return set_learn<true, invariant, sqrt_rate, adaptive, normalized, spare, next>(all, feature_mask_off, g);
+    return set_learn<true, invariant, sqrt_rate, adaptive, normalized, spare, next>(all, feature_mask_off, split, g);
   else
-    return set_learn<false, invariant, sqrt_rate, adaptive, normalized, spare, next>(all, feature_mask_off, g);
+    return set_learn<false, invariant, sqrt_rate, adaptive, normalized, spare, next>(all, feature_mask_off, split, g);
 }
 
 template<bool sqrt_rate, uint32_t adaptive, uint32_t normalized, uint32_t spare, uint32_t next>
-uint32_t set_learn(vw& all, bool feature_mask_off, gd& g)
+uint32_t set_learn(vw& all, bool feature_mask_off, bool split, gd& g)
 {
   if (all.invariant_updates)
-    return set_learn<true, sqrt_rate, adaptive, normalized, spare, next>(all, feature_mask_off, g);
+    return set_learn<true, sqrt_rate, adaptive, normalized, spare, next>(all, feature_mask_off, split, g);
   else
-    return set_learn<false, sqrt_rate, adaptive, normalized, spare, next>(all, feature_mask_off, g);
+    return set_learn<false, sqrt_rate, adaptive, normalized, spare, next>(all, feature_mask_off, split, g);
 }
 
 template<bool sqrt_rate, uint32_t adaptive, uint32_t spare>
-uint32_t set_learn(vw& all, bool feature_mask_off, gd& g)
+uint32_t set_learn(vw& all, bool feature_mask_off, bool split, gd& g)
 {
   // select the appropriate learn function based on adaptive, normalization, and feature mask
   if (all.normalized_updates)
-    return set_learn<sqrt_rate, adaptive, adaptive+1, adaptive+2, adaptive+3>(all, feature_mask_off, g);
+    return set_learn<sqrt_rate, adaptive, adaptive+1, adaptive+2, adaptive+3>(all, feature_mask_off, split, g);
   else
-    return set_learn<sqrt_rate, adaptive, 0, spare, spare+1>(all, feature_mask_off, g);
+    return set_learn<sqrt_rate, adaptive, 0, spare, spare+1>(all, feature_mask_off, split, g);
 }
 
 template<bool sqrt_rate>
-uint32_t set_learn(vw& all, bool feature_mask_off, gd& g)
+uint32_t set_learn(vw& all, bool feature_mask_off, bool split, gd& g)
 {
   if (all.adaptive)
-    return set_learn<sqrt_rate, 1, 2>(all, feature_mask_off, g);
+    return set_learn<sqrt_rate, 1, 2>(all, feature_mask_off, split, g);
   else
-    return set_learn<sqrt_rate, 0, 0>(all, feature_mask_off, g);
+    return set_learn<sqrt_rate, 0, 0>(all, feature_mask_off, split, g);
 }
 
 uint32_t ceil_log_2(uint32_t v)
@@ -946,7 +1924,14 @@ base_learner* setup(vw& all)
     ("adaptive", "use adaptive, individual learning rates.")
     ("invariant", "use safe/importance aware updates.")
     ("normalized", "use per feature normalized updates")
-    ("sparse_l2", po::value<float>()->default_value(0.f), "use per feature normalized updates");
+    ("sparse_l2", po::value<float>()->default_value(0.f), "use per feature normalized updates")
+    ("minibatch", po::value<size_t>(), "sum the gradients of arg examples and apply them at once")
+    ("minibatch_threads", po::value<size_t>()->default_value(1), "number of threads summing the gradients of a minibatch")
+    ("split_weights", "keep the adaptive and normalized state apart from the weights, so predicting reads only the weights")
+    ("quantize", po::value<string>(), "with -t, keep the weights as fp16, bf16 or int8 to use less memory")
+    ("quantize_report", "with --quantize, also predict with the fp32 weights and report how far the predictions move")
+    ("sparse_weights", "keep only the weights that were written in a hash table, for a large -b with few features")
+    ("delta_checkpoints", "after the first, save examples write only the weights learned since the last one, to <file>.delta.<n>");
   add_options(all);
   po::variables_map& vm = all.vm;
   gd& g = calloc_or_die<gd>();
@@ -1016,19 +2001,122 @@ base_learner* setup(vw& all)
   else {
     g.predict = predict<false, false>;   g.multipredict = multipredict<false, false>; }
 
+  // --split_weights leaves a dense weight vector, with the stride-1 floats
+  // of state after each weight moved to all.reg.state_vector
+  bool split = vm.count("split_weights") && (all.adaptive || all.normalized_updates);
+  if (vm.count("split_weights"))
+    *all.file_options << " --split_weights";
+
   uint32_t stride;
   if (all.power_t == 0.5)
-    stride = set_learn<true>(all, feature_mask_off, g);
+    stride = set_learn<true>(all, feature_mask_off, split, g);
+  else
+    stride = set_learn<false>(all, feature_mask_off, split, g);
+  if (split)
+    {
+      all.reg.state_stride = stride - 1;
+      all.reg.stride_shift = 0;
+    }
   else
-    stride = set_learn<false>(all, feature_mask_off, g);
-  all.reg.stride_shift = ceil_log_2(stride-1);
+    all.reg.stride_shift = ceil_log_2(stride-1);
+
+  if (vm.count("minibatch"))
+    {
+      g.batch_size = vm["minibatch"].as<size_t>();
+      size_t threads = vm["minibatch_threads"].as<size_t>();
+      if (g.batch_size == 0 || threads == 0)
+	{
+	  cerr << "error: --minibatch and --minibatch_threads must be at least 1" << endl;
+	  throw exception();
+	}
+      if (all.reg_mode || g.sparse_l2 > 0.f || all.learner_threads > 1)
+	{
+	  cerr << "error: --minibatch can not be used with --l1, --l2, --sparse_l2 or --learner_threads" << endl;
+	  throw exception();
+	}
+      if (!all.quiet)
+	cerr << "minibatch = " << g.batch_size << endl;
+      init_minibatch(g, threads);
+      g.learn = learn_batch;
+    }
+
+  // search_graph reads the weight array directly
+  bool search_graph = vm.count("search_task") && vm["search_task"].as<string>() == "graph";
+  if (vm.count("quantize"))
+    {
+      g.quantize = parse_quantize(vm["quantize"].as<string>());
+      g.quantize_report = vm.count("quantize_report") > 0;
+      if (all.training)
+	{
+	  cerr << "error: --quantize is for predicting only, use it with -t" << endl;
+	  throw exception();
+	}
+      // the weights are gone, so nothing may read or save them
+      if (all.reg_mode || all.audit || all.hash_inv || vm.count("feature_mask") || g.batch != nullptr
+	  || all.final_regressor_name != "" || all.text_regressor_name != ""
+	  || vm.count("lrq") || vm.count("lrqfa") || vm.count("stage_poly") || search_graph)
+	{
+	  cerr << "error: --quantize can not be used with --l1, --l2, --audit, --invert_hash, --feature_mask, --minibatch, -f, --readable_model, --lrq, --lrqfa, --stage_poly or --search_task graph" << endl;
+	  throw exception();
+	}
+      if (g.quantize_report && all.learner_threads > 1)
+	{
+	  cerr << "error: --quantize_report can not be used with --learner_threads" << endl;
+	  throw exception();
+	}
+      if (!all.quiet)
+	cerr << "quantize = " << quantize_name(g.quantize) << endl;
+      if (g.quantize == QUANTIZE_FP16)
+	set_predict_quantized<fp16_weights>(g, g.quantize_report);
+      else if (g.quantize == QUANTIZE_BF16)
+	set_predict_quantized<bf16_weights>(g, g.quantize_report);
+      else
+	set_predict_quantized<int8_weights>(g, g.quantize_report);
+    }
+
+  if (vm.count("sparse_weights"))
+    {
+      g.sparse = true;
+      // each of these reads or writes a dense weight array, or inserts
+      // rows from several threads
+      if (g.batch != nullptr || vm.count("split_weights") || g.quantize != QUANTIZE_OFF || all.learner_threads > 1
+	  || vm.count("feature_mask") || vm.count("random_weights") || vm.count("span_server")
+	  || vm.count("lrq") || vm.count("lrqfa") || vm.count("stage_poly") || all.mmap_model || all.chunked_model || search_graph)
+	{
+	  cerr << "error: --sparse_weights can not be used with --minibatch, --split_weights, --quantize, --learner_threads, --feature_mask, --random_weights, --span_server, --lrq, --lrqfa, --stage_poly, --mmap_model, --chunked_model or --search_task graph" << endl;
+	  throw exception();
+	}
+    }
+
+  if (vm.count("delta_checkpoints"))
+    {
+      g.delta_checkpoints = true;
+      // the rows are marked as examples are learned, so the weights may not
+      // change another way
+      if (g.batch != nullptr || g.sparse || all.mmap_model || vm.count("span_server")
+	  || vm.count("stage_poly") || vm.count("log_multi"))
+	{
+	  cerr << "error: --delta_checkpoints can not be used with --minibatch, --sparse_weights, --mmap_model, --span_server, --stage_poly or --log_multi" << endl;
+	  throw exception();
+	}
+    }
 
   learner<gd>& ret = init_learner(&g, g.learn, ((uint64_t)1 << all.reg.stride_shift));
   ret.set_predict(g.predict);
-  ret.set_multipredict(g.multipredict);
+  if (g.quantize == QUANTIZE_OFF && !g.sparse)
+    ret.set_multipredict(g.multipredict);
   ret.set_update(g.update);
   ret.set_save_load(save_load);
   ret.set_end_pass(end_pass);
+  if (g.batch != nullptr)
+    {
+      ret.set_end_examples(apply_batch);
+      ret.set_finish(finish_minibatch);
+    }
+  if (g.quantize != QUANTIZE_OFF)
+    ret.set_finish(finish_quantized);
+  if (g.sparse)
+    ret.set_finish(finish_sparse);
   return make_base(ret);
 }
 }
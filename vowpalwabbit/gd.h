@@ -10,6 +10,12 @@
 
 #include "parse_regressor.h"
 #include "constant.h"
+#include "interactions.h"
+#include "sparse_weights.h"
+// the gather kernel reads features as pairs of x and a 32 bit index
+#if !defined(VW_NO_INLINE_SIMD) && !defined(VW_64BIT_INDICES) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64)) && (defined(__GNUC__) || defined(_MSC_VER))
+#define VW_GATHER_KERNELS
+#endif
 
 namespace GD{
   LEARNER::base_learner* setup(vw& all);
@@ -23,14 +29,14 @@ namespace GD{
 
   struct multipredict_info { size_t count; size_t step; polyprediction* pred; regressor* reg; /* & for l1: */ float gravity; };
 
-  inline void vec_add_multipredict(multipredict_info& mp, const float fx, uint32_t fi) {
+  inline void vec_add_multipredict(multipredict_info& mp, const float fx, feature_index fi) {
     if ((-1e-10 < fx) && (fx < 1e-10)) return;
     weight*w    = mp.reg->weight_vector;
     size_t mask = mp.reg->weight_mask;
     polyprediction* p = mp.pred;
 
     fi &= mask;
-    uint32_t top = fi + (mp.count-1) * mp.step;
+    feature_index top = fi + (mp.count-1) * mp.step;
     if (top <= mask) {
       weight* last = w + top;
       w += fi;
@@ -45,58 +51,72 @@ namespace GD{
   
   // iterate through one namespace (or its part), callback function T(some_data_R, feature_value_x, feature_weight)
   template <class R, void (*T)(R&, const float, float&)>
-  inline void foreach_feature(weight* weight_vector, size_t weight_mask, feature* begin, feature* end, R& dat, uint32_t offset=0, float mult=1.)
+  inline void foreach_feature(weight* weight_vector, size_t weight_mask, feature* begin, feature* end, R& dat, feature_index offset=0, float mult=1.)
   {
     for (feature* f = begin; f!= end; f++)
       T(dat, mult*f->x, weight_vector[(f->weight_index + offset) & weight_mask]);
   }
 
   // iterate through one namespace (or its part), callback function T(some_data_R, feature_value_x, feature_index)
-  template <class R, void (*T)(R&, float, uint32_t)>
-   void foreach_feature(weight* weight_vector, size_t weight_mask, feature* begin, feature* end, R&dat, uint32_t offset=0, float mult=1.)
+  template <class R, void (*T)(R&, float, feature_index)>
+   void foreach_feature(weight* weight_vector, size_t weight_mask, feature* begin, feature* end, R&dat, feature_index offset=0, float mult=1.)
    {
      for (feature* f = begin; f!= end; f++)
        T(dat, mult*f->x, f->weight_index + offset);
    }
+
+  // whether kernel T only reads the weights, so that with --sparse_weights a
+  // weight not in the table need not be added for it
+  template <class R, void (*T)(R&, const float, float&)>
+  struct reads_weights { static const bool value = false; };
+
+  // the same two over --sparse_weights
+  template <class R, void (*T)(R&, const float, float&)>
+  inline void foreach_feature(sparse_weights* weights, size_t weight_mask, feature* begin, feature* end, R& dat, feature_index offset=0, float mult=1.)
+  {
+    for (feature* f = begin; f!= end; f++)
+      T(dat, mult*f->x, sparse_weight(*weights, (f->weight_index + offset) & weight_mask, !reads_weights<R,T>::value));
+  }
+
+  template <class R, void (*T)(R&, float, feature_index)>
+  inline void foreach_feature(sparse_weights*, size_t, feature* begin, feature* end, R&dat, feature_index offset=0, float mult=1.)
+  {
+    for (feature* f = begin; f!= end; f++)
+      T(dat, mult*f->x, f->weight_index + offset);
+  }
  
-  // iterate through all namespaces and quadratic&cubic features, callback function T(some_data_R, feature_value_x, S)
-  // where S is EITHER float& feature_weight OR uint32_t feature_index
-  template <class R, class S, void (*T)(R&, float, S)>
-  inline void foreach_feature(vw& all, example& ec, R& dat)
+  // the interaction engine's kernel for foreach_feature; W is weight* or sparse_weights*
+  template <class R, class S, void (*T)(R&, float, S), class W>
+  struct interaction_sweep {
+    W weights;
+    size_t weight_mask;
+    uint32_t offset;
+    R& dat;
+    inline void operator()(const string&, size_t, feature**, feature* begin, feature* end, feature_index halfhash, float mult)
+    { foreach_feature<R,T>(weights, weight_mask, begin, end, dat, halfhash + offset, mult); }
+  };
+
+  template <class R, class S, void (*T)(R&, float, S), class W>
+  inline void foreach_feature(vw& all, example& ec, R& dat, W weights)
   {
     uint32_t offset = ec.ft_offset;
 
     for (unsigned char* i = ec.indices.begin; i != ec.indices.end; i++)
-      foreach_feature<R,T>(all.reg.weight_vector, all.reg.weight_mask, ec.atomics[*i].begin, ec.atomics[*i].end, dat, offset);
-     
-    for (vector<string>::iterator i = all.pairs.begin(); i != all.pairs.end();i++) {
-      if (ec.atomics[(unsigned char)(*i)[0]].size() > 0) {
-        v_array<feature> temp = ec.atomics[(unsigned char)(*i)[0]];
-        for (; temp.begin != temp.end; temp.begin++)
-        {
-          uint32_t halfhash = quadratic_constant * (temp.begin->weight_index) + offset;
-       
-          foreach_feature<R,T>(all.reg.weight_vector, all.reg.weight_mask, ec.atomics[(unsigned char)(*i)[1]].begin, ec.atomics[(unsigned char)(*i)[1]].end, dat, 
-                               halfhash, temp.begin->x);
-        }
-      }
-    }
-
-    for (vector<string>::iterator i = all.triples.begin(); i != all.triples.end();i++) {
-      if ((ec.atomics[(unsigned char)(*i)[0]].size() == 0) || (ec.atomics[(unsigned char)(*i)[1]].size() == 0) || (ec.atomics[(unsigned char)(*i)[2]].size() == 0)) { continue; }
-      v_array<feature> temp1 = ec.atomics[(unsigned char)(*i)[0]];
-      for (; temp1.begin != temp1.end; temp1.begin++) {
-        v_array<feature> temp2 = ec.atomics[(unsigned char)(*i)[1]];
-        for (; temp2.begin != temp2.end; temp2.begin++) {
-
-          uint32_t a = temp1.begin->weight_index;
-          uint32_t b = temp2.begin->weight_index;
-          uint32_t halfhash = cubic_constant2 * (cubic_constant * a + b) + offset;
-          float mult = temp1.begin->x * temp2.begin->x;
-          foreach_feature<R,T>(all.reg.weight_vector, all.reg.weight_mask, ec.atomics[(unsigned char)(*i)[2]].begin, ec.atomics[(unsigned char)(*i)[2]].end, dat, halfhash, mult);
-        }
-      }
-    }
+      foreach_feature<R,T>(weights, all.reg.weight_mask, ec.atomics[*i].begin, ec.atomics[*i].end, dat, offset);
+
+    interaction_sweep<R,S,T,W> sweep = {weights, all.reg.weight_mask, offset, dat};
+    INTERACTIONS::foreach_interaction(all, ec, sweep);
+  }
+
+  // iterate through all namespaces and quadratic&cubic features, callback function T(some_data_R, feature_value_x, S)
+  // where S is EITHER float& feature_weight OR feature_index index
+  template <class R, class S, void (*T)(R&, float, S)>
+  inline void foreach_feature(vw& all, example& ec, R& dat)
+  {
+    if (all.reg.sparse != nullptr)
+      foreach_feature<R,S,T>(all, ec, dat, all.reg.sparse);
+    else
+      foreach_feature<R,S,T>(all, ec, dat, all.reg.weight_vector);
   }
 
   // iterate through all namespaces and quadratic&cubic features, callback function T(some_data_R, feature_value_x, feature_weight)
@@ -108,6 +128,28 @@ namespace GD{
 
  inline void vec_add(float& p, const float fx, float& fw) { p += fw * fx; }
 
+  template <>
+  struct reads_weights<float, vec_add> { static const bool value = true; };
+
+#ifdef VW_GATHER_KERNELS
+  // Prediction spends its time in the inner loop over the second namespace
+  // of each -q pair.  When the cpu has AVX2, gd.cc hashes eight features at
+  // once and fetches their weights with a gather.  Updates stay scalar: they
+  // write the weights back, and two features of a vector can share a weight.
+  extern const bool avx2_kernels;
+  float dot_features_avx2(weight* weight_vector, uint32_t weight_mask, feature* begin, feature* end, uint32_t offset, float mult);
+
+  template<>
+  inline void foreach_feature<float, vec_add>(weight* weight_vector, size_t weight_mask, feature* begin, feature* end, float& dat, feature_index offset, float mult)
+  {
+    if (avx2_kernels && end - begin >= 8 && weight_mask <= 0x7FFFFFFF) // gather indices are signed
+      dat += dot_features_avx2(weight_vector, (uint32_t)weight_mask, begin, end, offset, mult);
+    else
+      for (feature* f = begin; f!= end; f++)
+        dat += weight_vector[(f->weight_index + offset) & weight_mask] * (mult * f->x);
+  }
+#endif
+
   inline float inline_predict(vw& all, example& ec)
   {
     float temp = ec.l.simple.initial;
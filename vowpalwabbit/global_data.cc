@@ -13,6 +13,7 @@ license as described in the file LICENSE.
 
 #include "global_data.h"
 #include "gd.h"
+#include "placement.h"
 
 using namespace std;
 
@@ -292,6 +293,12 @@ vw::vw()
   num_children = 10;
   span_server = "";
   save_resume = false;
+  mmap_model = false;
+  chunked_model = false;
+  loaded_layout = WEIGHTS_AS_PAIRS;
+  model_threads = 1;
+  delta_number = 0;
+  checkpoint_base = 0;
 
   random_positive_weights = false;
 
@@ -350,6 +357,18 @@ vw::vw()
   add_constant = true;
   audit = false;
   reg.weight_vector = nullptr;
+  reg.state_vector = nullptr;
+  reg.state_stride = 0;
+  reg.quantized = nullptr;
+  reg.sparse = nullptr;
+  reg.dirty_rows = nullptr;
+  weight_bytes_mapped = 0;
+  state_bytes_mapped = 0;
+  dirty_bytes_mapped = 0;
+  huge_pages = HUGE_PAGES_OFF;
+  numa_node = numa_default;
+  pin_threads = false;
+  next_cpu = 0;
   pass_length = (size_t)-1;
   passes_complete = 0;
 
@@ -365,7 +384,11 @@ vw::vw()
 
   max_examples = (size_t)-1;
 
+  learner_threads = 1;
+  stack_depth = 0;
   hash_inv = false;
+  symmetric_interactions = false;
+  no_self_interactions = false;
   print_invert = false;
 
   // Set by the '--progress <arg>' option and affect sd->dump_interval
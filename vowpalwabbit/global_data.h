@@ -116,10 +116,21 @@ const version_struct version(PACKAGE_VERSION);
 
 typedef float weight;
 
+struct quantized_weights;
+struct sparse_weights;
+
 struct regressor {
   weight* weight_vector;
   size_t weight_mask; // (stride*(1 << num_bits) -1)
   uint32_t stride_shift;
+  // With --split_weights the update state of weight i is kept apart from
+  // weight_vector, which then holds only the weights, in
+  // state_vector[i*state_stride + 1 .. i*state_stride + state_stride].
+  weight* state_vector;
+  uint32_t state_stride; // 0 when the state is interleaved with the weights
+  quantized_weights* quantized; // the compact weights of --quantize, else nullptr
+  sparse_weights* sparse; // the table of --sparse_weights, else nullptr
+  unsigned char* dirty_rows; // --delta_checkpoints: nonzero for each row learned since the last checkpoint, else nullptr
 };
 
 typedef v_hashmap< substring, v_array<feature>* > feature_dict;
@@ -158,6 +169,12 @@ struct shared_data {
   double holdout_sum_loss_since_last_pass;
   size_t holdout_best_pass;
 
+  // the file the delta checkpoints are being saved on (a hash of its name,
+  // 0 for none) and how many there are; here so daemon children share them
+  uint64_t checkpoint_name;
+  uint32_t checkpoint_deltas;
+  uint64_t checkpoint_base; // the id of the whole model the deltas are on
+
   // Column width, precision constants:
   static const int col_avg_loss = 8;
   static const int prec_avg_loss = 6;
@@ -318,6 +335,10 @@ struct shared_data {
   }
 };
 
+// how a model file holds the weights: (index, value) pairs, an array to map
+// (--mmap_model) or compressed chunks (--chunked_model)
+enum weight_layout { WEIGHTS_AS_PAIRS, WEIGHTS_MAPPABLE, WEIGHTS_CHUNKED };
+
 struct vw {
   shared_data* sd;
 
@@ -327,10 +348,12 @@ struct vw {
 #else
   HANDLE parse_thread;
 #endif
+  size_t learner_threads; // threads learning on the shared weights (--learner_threads)
 
   node_socks socks;
 
   LEARNER::base_learner* l;//the top level learner
+  size_t stack_depth; // number of learners in the reduction stack
   LEARNER::base_learner* scorer;//a scoring function
   LEARNER::base_learner* cost_sensitive;//a cost sensitive learning algorithm.
 
@@ -356,6 +379,13 @@ struct vw {
   bool hessian_on;
 
   bool save_resume;
+  bool mmap_model; // save the weights as page aligned arrays (--mmap_model)
+  bool chunked_model; // save them as compressed chunks (--chunked_model)
+  size_t model_threads; // that encode or decode the chunks
+  int loaded_layout; // a weight_layout, of the model file last read, as its options say
+  string model_name; // of the model file being read, whose delta checkpoints gd applies after it
+  uint32_t delta_number; // of the delta checkpoint being saved, 0 when saving a whole model
+  uint64_t checkpoint_base; // the base id in the header of the model being saved or last read, 0 for none
   version_struct model_file_ver;
   double normalized_sum_norm_x;
   bool vw_is_main;  // true if vw is executable; false in library mode
@@ -387,6 +417,9 @@ struct vw {
   size_t parse_mask; // 1 << num_bits -1
   std::vector<std::string> pairs; // pairs of features to cross.
   std::vector<std::string> triples; // triples of features to cross.
+  std::vector<std::string> interactions; // crosses of any number of namespaces, from --interactions
+  bool symmetric_interactions; // use each combination of a repeated namespace's features once
+  bool no_self_interactions; // and never a feature with itself
   bool ignore_some;
   bool ignore[256];//a set of namespaces to ignore
 
@@ -457,6 +490,14 @@ struct vw {
 
   std::string final_regressor_name;
   regressor reg;
+  size_t weight_bytes_mapped; // length of the mmap behind reg.weight_vector, 0 when it was calloced
+  size_t state_bytes_mapped; // the same for reg.state_vector
+  size_t dirty_bytes_mapped; // and for reg.dirty_rows
+  int huge_pages; // a huge_page_mode, for the weights (--huge_pages)
+  int numa_node; // node to bind the weights to, or numa_interleave or numa_default (--numa)
+  bool pin_threads; // give each parse and learner thread a cpu (--pin_threads)
+  std::vector<int> cpus; // the cpus the process may use, handed out in turn
+  std::atomic<size_t> next_cpu;
 
   size_t max_examples; // for TLC
 
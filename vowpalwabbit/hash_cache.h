@@ -0,0 +1,88 @@
+/*
+Copyright (c) by respective owners including Yahoo!, Microsoft, and
+individual contributors. All rights reserved.  Released under a BSD
+license as described in the file LICENSE.
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "parse_primitives.h"
+#include "memory.h"
+
+// Remembers the hashes of recently seen feature names (--hash_cache), so a
+// token repeated across many examples is hashed once.  The table is direct
+// mapped on the name and its seed, and a miss just replaces the entry.  Only
+// names of up to 48 bytes are kept; longer ones always go to the hasher.
+// Each parser thread has its own table, so no locking is needed.  Hashing a
+// short name costs about as much as a probe that misses the cpu cache, so
+// this pays off for long, frequently repeated names in a table that stays
+// cached; the hit rate is printed at the end to help size it.
+struct hash_cache_entry { // 64 bytes, a cache line
+  uint64_t head; // the first 8 bytes of the name, zero padded
+  uint64_t tail; // the last 8 when it is longer than that
+  uint32_t seed;
+  uint32_t length; // 0 for an empty entry
+  uint64_t hash;
+  char middle[32]; // the bytes between head and tail
+};
+
+struct hash_cache {
+  hash_cache_entry* entries;
+  size_t mask; // number of entries - 1
+  uint64_t lookups;
+  uint64_t hits;
+};
+
+inline void init_hash_cache(hash_cache& c, size_t bits)
+{
+  c.entries = calloc_or_die<hash_cache_entry>((size_t)1 << bits);
+  c.mask = ((size_t)1 << bits) - 1;
+  c.lookups = c.hits = 0;
+}
+
+inline void free_hash_cache(hash_cache& c)
+{
+  free(c.entries);
+  c.entries = nullptr;
+}
+
+inline size_t cached_hash(hash_cache& c, hash_func_t hasher, substring s, uint32_t seed)
+{
+  size_t length = s.end - s.begin;
+  if (c.entries == nullptr || length == 0 || length > 16 + sizeof(c.entries->middle))
+    return hasher(s, seed);
+
+  uint64_t head = 0, tail = 0;
+  if (length >= sizeof(head))
+    {
+      memcpy(&head, s.begin, sizeof(head));
+      memcpy(&tail, s.end - sizeof(tail), sizeof(tail));
+    }
+  else
+    for (size_t i = 0; i < length; i++)
+      head |= (uint64_t)(unsigned char)s.begin[i] << (8 * i);
+  size_t middle = length > 16 ? length - 16 : 0;
+
+  uint64_t mix = head ^ (tail * 0x9E3779B97F4A7C15ULL) ^ ((uint64_t)seed << 32 | length);
+  mix ^= mix >> 33;
+  mix *= 0xFF51AFD7ED558CCDULL;
+  mix ^= mix >> 33;
+  hash_cache_entry& e = c.entries[mix & c.mask];
+  c.lookups++;
+  if (e.head == head && e.tail == tail && e.length == length && e.seed == seed
+      && (middle == 0 || memcmp(e.middle, s.begin + 8, middle) == 0))
+    {
+      c.hits++;
+      return e.hash;
+    }
+
+  size_t hash = hasher(s, seed);
+  e.head = head;
+  e.tail = tail;
+  e.seed = seed;
+  e.length = (uint32_t)length;
+  e.hash = hash;
+  if (middle > 0)
+    memcpy(e.middle, s.begin + 8, middle);
+  return hash;
+}
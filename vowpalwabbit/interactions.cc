@@ -0,0 +1,64 @@
+/*
+Copyright (c) by respective owners including Yahoo!, Microsoft, and
+individual contributors. All rights reserved.  Released under a BSD
+license as described in the file LICENSE.
+ */
+#include <math.h>
+#include "interactions.h"
+
+using namespace std;
+
+namespace INTERACTIONS
+{
+  // ways to choose r features out of n as the engine does for a namespace
+  // repeated r times in a row
+  static size_t combinations(size_t n, size_t r, bool self)
+  {
+    size_t top = self ? n + r - 1 : n;
+    if (top < r)
+      return 0;
+    size_t c = 1;
+    for (size_t k = 1; k <= r; k++)
+      c = c * (top - r + k) / k;
+    return c;
+  }
+
+  static void eval_term(vw& all, example& ec, const string& term, size_t arity, size_t& num_features, float& sum_feat_sq)
+  {
+    size_t count = 1;
+    float sum = 1.f;
+    for (size_t i = 0; i < arity;)
+      {
+        unsigned char ns = (unsigned char)term[i];
+        size_t r = 1;
+        if (all.symmetric_interactions)
+          while (i + r < arity && (unsigned char)term[i + r] == ns)
+            r++;
+        size_t n = ec.atomics[ns].size();
+        if (r == 1)
+          {
+            count *= n;
+            sum *= ec.sum_feat_sq[ns];
+          }
+        else
+          { // the squared values are taken to be spread evenly over the features
+            size_t c = combinations(n, r, !all.no_self_interactions);
+            count *= c;
+            sum *= n == 0 ? 0.f : powf(ec.sum_feat_sq[ns], (float)r) * (float)c / powf((float)n, (float)r);
+          }
+        i += r;
+      }
+    num_features += count;
+    sum_feat_sq += sum;
+  }
+
+  void eval_count_of_interactions(vw& all, example& ec, size_t& num_features, float& sum_feat_sq)
+  {
+    for (vector<string>::iterator i = all.pairs.begin(); i != all.pairs.end(); i++)
+      eval_term(all, ec, *i, 2, num_features, sum_feat_sq);
+    for (vector<string>::iterator i = all.triples.begin(); i != all.triples.end(); i++)
+      eval_term(all, ec, *i, 3, num_features, sum_feat_sq);
+    for (vector<string>::iterator i = all.interactions.begin(); i != all.interactions.end(); i++)
+      eval_term(all, ec, *i, i->size(), num_features, sum_feat_sq);
+  }
+}
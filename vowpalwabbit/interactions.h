@@ -0,0 +1,120 @@
+/*
+Copyright (c) by respective owners including Yahoo!, Microsoft, and
+individual contributors. All rights reserved.  Released under a BSD
+license as described in the file LICENSE.
+ */
+#pragma once
+#include "global_data.h"
+#include "constant.h"
+
+// Walks the features of an interaction of namespaces (the -q pairs, the
+// --cubic triples and the --interactions of any length).  For every choice
+// of features from all but the last namespace the kernel is called once
+// with the last namespace's features and
+//   kernel(term, arity, outer, begin, end, halfhash, mult)
+// where outer holds the chosen features, halfhash is to be added to each
+// weight_index in [begin, end) and mult multiplies each x.  The hashes of
+// pairs and triples are the ones vw has always used; longer interactions
+// extend the cubic one.  Arities 2, 3 and 4 are unrolled at compile time.
+//
+// With all.symmetric_interactions, a namespace repeated next to itself in a
+// term (as in -q aa) pairs each feature with itself and the ones after it
+// only, so (i,j) and (j,i) are not both used; all.no_self_interactions also
+// drops (i,i).
+namespace INTERACTIONS
+{
+  template <class K>
+  struct walk {
+    vw& all;
+    const std::string& term;
+    v_array<feature>* fs[256];
+    feature* outer[256];
+    K& kernel;
+    walk(vw& all, const std::string& term, K& kernel) : all(all), term(term), kernel(kernel) {}
+
+    inline feature* first(size_t depth)
+    {
+      if (depth > 0 && all.symmetric_interactions && term[depth] == term[depth-1])
+        return outer[depth-1] + (all.no_self_interactions ? 1 : 0);
+      return fs[depth]->begin;
+    }
+
+    inline feature_index next_hash(size_t depth, feature_index hash, feature* f)
+    {
+      if (depth == 0)
+        return f->weight_index;
+      return cubic_constant2 * (cubic_constant * hash + f->weight_index);
+    }
+
+    inline void last(size_t arity, feature_index hash, float mult)
+    {
+      feature* begin = first(arity-1);
+      feature* end = fs[arity-1]->end;
+      if (begin < end)
+        kernel(term, arity, outer, begin, end, arity == 2 ? quadratic_constant * hash : hash, mult);
+    }
+
+    // any arity, for terms longer than the unrolled ones
+    void general(size_t depth, feature_index hash, float mult)
+    {
+      if (depth + 1 == term.size())
+        return last(depth + 1, hash, mult);
+      for (feature* f = first(depth); f < fs[depth]->end; f++)
+        {
+          outer[depth] = f;
+          general(depth + 1, next_hash(depth, hash, f), depth == 0 ? f->x : mult * f->x);
+        }
+    }
+  };
+
+  template <size_t depth, size_t arity, class K, bool inner = (depth + 1 == arity)>
+  struct unrolled {
+    static inline void run(walk<K>& w, feature_index hash, float mult)
+    {
+      for (feature* f = w.first(depth); f < w.fs[depth]->end; f++)
+        {
+          w.outer[depth] = f;
+          unrolled<depth + 1, arity, K>::run(w, w.next_hash(depth, hash, f), depth == 0 ? f->x : mult * f->x);
+        }
+    }
+  };
+
+  template <size_t depth, size_t arity, class K>
+  struct unrolled<depth, arity, K, true> {
+    static inline void run(walk<K>& w, feature_index hash, float mult) { w.last(arity, hash, mult); }
+  };
+
+  template <class K>
+  inline void foreach_term(vw& all, example& ec, const std::string& term, size_t arity, K& kernel)
+  {
+    walk<K> w(all, term, kernel);
+    for (size_t i = 0; i < arity; i++)
+      {
+        w.fs[i] = &ec.atomics[(unsigned char)term[i]];
+        if (w.fs[i]->begin == w.fs[i]->end)
+          return;
+      }
+    switch (arity)
+      {
+      case 2: unrolled<0, 2, K>::run(w, 0, 1.f); break;
+      case 3: unrolled<0, 3, K>::run(w, 0, 1.f); break;
+      case 4: unrolled<0, 4, K>::run(w, 0, 1.f); break;
+      default: w.general(0, 0, 1.f);
+      }
+  }
+
+  template <class K>
+  inline void foreach_interaction(vw& all, example& ec, K& kernel)
+  {
+    for (std::vector<std::string>::iterator i = all.pairs.begin(); i != all.pairs.end(); i++)
+      foreach_term(all, ec, *i, 2, kernel);
+    for (std::vector<std::string>::iterator i = all.triples.begin(); i != all.triples.end(); i++)
+      foreach_term(all, ec, *i, 3, kernel);
+    for (std::vector<std::string>::iterator i = all.interactions.begin(); i != all.interactions.end(); i++)
+      foreach_term(all, ec, *i, i->size(), kernel);
+  }
+
+  // the number of interaction features of ec and the sum of their squared
+  // values, for setup_example
+  void eval_count_of_interactions(vw& all, example& ec, size_t& num_features, float& sum_feat_sq);
+}
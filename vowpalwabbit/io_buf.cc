@@ -6,7 +6,13 @@ license as described in the file LICENSE.
 #include "io_buf.h"
 #ifdef WIN32
 #include <winsock2.h>
+#else
+#include <pthread.h>
+#include <poll.h>
 #endif
+#include <sys/stat.h>
+#include "parse_primitives.h"
+#include "memory.h"
 
 size_t buf_read(io_buf &i, char* &pointer, size_t n)
 {//return a pointer to the next n bytes.  n must be smaller than the maximum size.
@@ -19,12 +25,7 @@ size_t buf_read(io_buf &i, char* &pointer, size_t n)
   else // out of bytes, so refill.
     {
       if (i.space.end != i.space.begin) //There exists room to shift.
-	{ // Out of buffer so swap to beginning.
-	  size_t left = i.endloaded - i.space.end;
-	  memmove(i.space.begin, i.space.end, left);
-	  i.space.end = i.space.begin;
-	  i.endloaded = i.space.begin+left;
-	}
+	i.shift_space(); // Out of buffer so swap to beginning.
       if (i.fill(i.files[i.current]) > 0)
 	return buf_read(i,pointer,n);// more bytes are read.
       else if (++i.current < i.files.size()) 
@@ -66,10 +67,7 @@ size_t readto(io_buf &i, char* &pointer, char terminal)
     {
       if (i.endloaded == i.space.end_array)
 	{
-	  size_t left = i.endloaded - i.space.end;
-	  memmove(i.space.begin, i.space.end, left);
-	  i.space.end = i.space.begin;
-	  i.endloaded = i.space.begin+left;
+	  i.shift_space();
 	  pointer = i.endloaded;
 	}
       if (i.current < i.files.size() && i.fill(i.files[i.current]) > 0)// more bytes are read.
@@ -146,3 +144,174 @@ void io_buf::close_file_or_socket(int f)
   close(f);
 #endif
 }
+
+const size_t read_ahead_buffers = 4;
+const size_t read_ahead_buffer_size = 1 << 20;
+
+struct read_ahead {
+  int fd;
+  v_array<char> buffers[read_ahead_buffers];
+  size_t taken; // bytes of the oldest filled buffer already returned
+  uint64_t filled; // buffers handed over by the reader thread
+  uint64_t drained; // buffers read_ahead_read is done with
+  bool eof; // the last filled buffer holds the end of the input
+  bool stop;
+  MUTEX lock;
+  CV changed;
+#ifndef _WIN32
+  pthread_t thread;
+#else
+  HANDLE thread;
+#endif
+};
+
+bool read_ahead_stopped(read_ahead& r)
+{
+  mutex_lock(&r.lock);
+  bool stop = r.stop;
+  mutex_unlock(&r.lock);
+  return stop;
+}
+
+// true when a read of r.fd won't block, false if we are being stopped first
+bool read_ahead_wait(read_ahead& r, int timeout)
+{
+#ifndef _WIN32
+  struct pollfd p = {r.fd, POLLIN, 0};
+  while (!read_ahead_stopped(r))
+    if (poll(&p, 1, timeout) != 0)
+      return true;
+    else if (timeout == 0)
+      return false;
+  return false;
+#else
+  return timeout != 0 && !read_ahead_stopped(r); // just block in the read
+#endif
+}
+
+#ifdef _WIN32
+DWORD WINAPI read_ahead_loop(LPVOID in)
+#else
+void *read_ahead_loop(void *in)
+#endif
+{
+  read_ahead& r = *(read_ahead*)in;
+  while (true)
+    {
+      mutex_lock(&r.lock);
+      while (r.filled - r.drained == read_ahead_buffers && !r.stop)
+	condition_variable_wait(&r.changed, &r.lock);
+      mutex_unlock(&r.lock);
+      if (!read_ahead_wait(r, 100))
+	return 0L;
+
+      // keep reading while more is waiting, so a buffer holds many small writes
+      v_array<char>& b = r.buffers[r.filled % read_ahead_buffers];
+      b.erase();
+      ssize_t num_read;
+      do
+	{
+	  num_read = io_buf::read_file_or_socket(r.fd, b.end, b.end_array - b.end);
+	  if (num_read > 0)
+	    b.end += num_read;
+	}
+      while (num_read > 0 && b.end != b.end_array && read_ahead_wait(r, 0));
+
+      mutex_lock(&r.lock);
+      r.filled++;
+      r.eof = num_read <= 0;
+      condition_variable_signal_all(&r.changed);
+      mutex_unlock(&r.lock);
+      if (num_read <= 0)
+	return 0L;
+    }
+}
+
+void io_buf::start_read_ahead(int f)
+{
+  struct stat st;
+  if (f < 0 || compressed() || find_read_ahead(f) != nullptr || (fstat(f, &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG))
+    return;
+
+  read_ahead& r = calloc_or_die<read_ahead>();
+  r.fd = f;
+  for (size_t i = 0; i < read_ahead_buffers; i++)
+    r.buffers[i].resize(read_ahead_buffer_size);
+  initialize_mutex(&r.lock);
+  initialize_condition_variable(&r.changed);
+#ifndef _WIN32
+  pthread_create(&r.thread, nullptr, read_ahead_loop, &r);
+#else
+  r.thread = ::CreateThread(nullptr, 0, static_cast<LPTHREAD_START_ROUTINE>(read_ahead_loop), &r, 0L, nullptr);
+#endif
+  ahead.push_back(&r);
+}
+
+read_ahead* io_buf::find_read_ahead(int f)
+{
+  for (read_ahead** r = ahead.begin; r != ahead.end; r++)
+    if ((*r)->fd == f)
+      return *r;
+  return nullptr;
+}
+
+void io_buf::stop_read_ahead(int f)
+{
+  read_ahead* r = find_read_ahead(f);
+  if (r == nullptr)
+    return;
+
+  mutex_lock(&r->lock);
+  r->stop = true;
+  condition_variable_signal_all(&r->changed);
+  mutex_unlock(&r->lock);
+#ifndef _WIN32
+  pthread_join(r->thread, nullptr);
+#else
+  ::WaitForSingleObject(r->thread, INFINITE);
+  ::CloseHandle(r->thread);
+#endif
+
+  for (size_t i = 0; i < read_ahead_buffers; i++)
+    r->buffers[i].delete_v();
+  delete_mutex(&r->lock);
+  for (read_ahead** p = ahead.begin; p != ahead.end; p++)
+    if (*p == r)
+      {
+	*p = ahead.last();
+	ahead.pop();
+	break;
+      }
+  free(r);
+}
+
+void io_buf::stop_read_aheads()
+{
+  while (ahead.size() > 0)
+    stop_read_ahead(ahead.last()->fd);
+}
+
+ssize_t io_buf::read_ahead_read(read_ahead* r, void* buf, size_t nbytes)
+{
+  mutex_lock(&r->lock);
+  while (r->filled == r->drained && !r->eof)
+    condition_variable_wait(&r->changed, &r->lock);
+  bool empty = r->filled == r->drained;
+  mutex_unlock(&r->lock);
+  if (empty)
+    return 0;
+
+  v_array<char>& b = r->buffers[r->drained % read_ahead_buffers];
+  size_t copy = min(nbytes, b.size() - r->taken);
+  memcpy(buf, b.begin + r->taken, copy);
+  r->taken += copy;
+  if (r->taken == b.size())
+    {
+      r->taken = 0;
+      mutex_lock(&r->lock);
+      r->drained++;
+      condition_variable_signal_all(&r->changed);
+      mutex_unlock(&r->lock);
+    }
+  return copy;
+}
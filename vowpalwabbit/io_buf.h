@@ -27,6 +27,8 @@ using namespace std;
 #include <sys/stat.h>
 #endif
 
+struct read_ahead; // a thread reading a descriptor ahead of the parser, see io_buf.cc
+
 class io_buf {
  public:
   v_array<char> space; //space.begin = beginning of loaded values.  space.end = end of read or written values.
@@ -36,6 +38,7 @@ class io_buf {
   char* endloaded; //end of loaded values
   v_array<char> currentname;
   v_array<char> finalname;
+  v_array<read_ahead*> ahead; // descriptors being read by a background thread
   
   static const int READ = 1;
   static const int WRITE = 2;
@@ -45,6 +48,7 @@ class io_buf {
     files = v_init<int>();
     currentname = v_init<char>();
     finalname = v_init<char>();
+    ahead = v_init<read_ahead*>();
     size_t s = 1 << 16;
     space.resize(s);
     current = 0;
@@ -108,11 +112,25 @@ class io_buf {
     space.end = space.begin;
   }
 
+  // moves f as lseek does, dropping what was loaded; -1 if f can't seek
+  virtual int64_t seek_file(int f, int64_t offset, int whence){
+#ifdef _WIN32
+    int64_t ret = _lseeki64(f, offset, whence);
+#else
+    int64_t ret = lseek(f, offset, whence);
+#endif
+    endloaded = space.begin;
+    space.end = space.begin;
+    return ret;
+  }
+
   io_buf() {
     init();
   }
 
   virtual ~io_buf(){
+    stop_read_aheads();
+    ahead.delete_v();
     files.delete_v();
     space.delete_v();
   }
@@ -122,12 +140,27 @@ class io_buf {
   virtual size_t num_files(){ return files.size();}
 
   virtual ssize_t read_file(int f, void* buf, size_t nbytes){
+    if (ahead.size() > 0)
+      {
+	read_ahead* r = find_read_ahead(f);
+	if (r != nullptr)
+	  return read_ahead_read(r, buf, nbytes);
+      }
     return read_file_or_socket(f, buf, nbytes);
   }
 
+  // Reading stdin, a pipe or a socket blocks in read() until the writer
+  // catches up, so read_file can instead take the bytes from a ring of
+  // buffers filled by a thread of its own.  Seekable files are left alone.
+  void start_read_ahead(int f);
+  void stop_read_ahead(int f); // before f is closed
+  void stop_read_aheads();
+  read_ahead* find_read_ahead(int f);
+  static ssize_t read_ahead_read(read_ahead* r, void* buf, size_t nbytes);
+
   static ssize_t read_file_or_socket(int f, void* buf, size_t nbytes);
 
-  size_t fill(int f) {
+  virtual size_t fill(int f) {
     if (space.end_array - endloaded == 0)
       {
 	size_t offset = endloaded - space.begin;
@@ -144,6 +177,14 @@ class io_buf {
       return 0;
   }
 
+  // move the unread bytes to the front of space to make room for a fill
+  virtual void shift_space() {
+    size_t left = endloaded - space.end;
+    memmove(space.begin, space.end, left);
+    space.end = space.begin;
+    endloaded = space.begin+left;
+  }
+
   virtual ssize_t write_file(int f, const void* buf, size_t nbytes) {
     return write_file_or_socket(f, buf, nbytes);
   }
@@ -157,7 +198,9 @@ class io_buf {
 
   virtual bool close_file(){
     if(files.size()>0){
-      close_file_or_socket(files.pop());
+      int f = files.pop();
+      stop_read_ahead(f);
+      close_file_or_socket(f);
       return true;
     }
     return false;
@@ -609,8 +609,8 @@ float lda_loop(lda &l, v_array<float> &Elogtheta, float *v, weight *weights, exa
     size_t word_count = 0;
     doc_length = 0;
     for (unsigned char *i = ec->indices.begin; i != ec->indices.end; i++) {
-      feature *f = ec->atomics[*i].begin;
-      for (; f != ec->atomics[*i].end; f++) {
+      v_array<feature>& features = ec->atomics[*i];
+      for (feature *f = features.begin; f != features.end; f++) {
         float *u_for_w = &weights[(f->weight_index & l.all->reg.weight_mask) + l.topics + 1];
         float c_w = find_cw(l, u_for_w, v);
         xc_w = c_w * f->x;
@@ -820,8 +820,8 @@ void learn(lda &l, LEARNER::base_learner &base, example &ec)
   l.examples.push_back(&ec);
   l.doc_lengths.push_back(0);
   for (unsigned char *i = ec.indices.begin; i != ec.indices.end; i++) {
-    feature *f = ec.atomics[*i].begin;
-    for (; f != ec.atomics[*i].end; f++) {
+    v_array<feature>& features = ec.atomics[*i];
+    for (feature *f = features.begin; f != features.end; f++) {
       index_feature temp = {(uint32_t)num_ex, *f};
       l.sorted_features.push_back(temp);
       l.doc_lengths[num_ex] += (int)f->x;
@@ -838,8 +838,8 @@ void predict(lda &l, LEARNER::base_learner &base, example &ec)
 	l.examples.push_back(&ec);
 	l.doc_lengths.push_back(0);
 	for (unsigned char *i = ec.indices.begin; i != ec.indices.end; i++) {
-		feature *f = ec.atomics[*i].begin;
-		for (; f != ec.atomics[*i].end; f++) {
+		v_array<feature>& features = ec.atomics[*i];
+		for (feature *f = features.begin; f != features.end; f++) {
 			index_feature temp = { (uint32_t)num_ex, *f };
 			l.sorted_features.push_back(temp);
 			l.doc_lengths[num_ex] += (int)f->x;
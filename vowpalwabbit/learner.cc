@@ -1,6 +1,7 @@
 #include "parser.h"
 #include "vw.h"
 #include "parse_regressor.h"
+#include "placement.h"
 
 void dispatch_example(vw& all, example& ec)
 {
@@ -13,11 +14,144 @@ void dispatch_example(vw& all, example& ec)
 
 namespace LEARNER
 {
+  inline bool is_save_example(example& ec)
+  { return ec.tag.size() >= 4 && !strncmp((const char*) ec.tag.begin, "save", 4); }
+
+  void save_state(vw& all, example* ec)
+  {
+    string final_regressor_name = all.final_regressor_name;
+
+    if ((ec->tag).size() >= 6 && (ec->tag)[4] == '_')
+      final_regressor_name = string(ec->tag.begin+5, (ec->tag).size()-5);
+
+    if (!all.quiet)
+      cerr << "saving regressor to " << final_regressor_name << endl;
+    if (all.reg.dirty_rows != nullptr)
+      save_checkpoint(all, final_regressor_name);
+    else
+      save_predictor(all, final_regressor_name, 0);
+
+    VW::finish_example(all,ec);
+  }
+
+  // With --learner_threads N, N threads run the loop below on the same
+  // weights without locking them (hogwild).  Taking an example off the ring
+  // and finishing it, which accounts for it and writes its prediction and
+  // the progress lines, are serialized; learning is not.  An end of pass or
+  // save example waits until every example before it is finished and keeps
+  // the other threads from taking more until it is done.
+  struct hogwild {
+    vw* all;
+    MUTEX take_lock;
+    MUTEX finish_lock;
+#ifndef _WIN32
+    pthread_t* threads;
+#else
+    HANDLE* threads;
+#endif
+  };
+
+  // waits until count examples have been finished
+  void wait_for_finished(parser* p, uint64_t count)
+  {
+    if (p->local_example_number == count)
+      return;
+    mutex_lock(&p->output_lock);
+    p->output_waiters++;
+    while (p->local_example_number != count)
+      condition_variable_wait(&p->output_done, &p->output_lock);
+    p->output_waiters--;
+    mutex_unlock(&p->output_lock);
+  }
+
+#ifdef _WIN32
+  DWORD WINAPI hogwild_loop(LPVOID in)
+#else
+  void *hogwild_loop(void *in)
+#endif
+  {
+    hogwild& h = *(hogwild*)in;
+    vw& all = *h.all;
+    parser* p = all.p;
+    pin_thread(all);
+    while (true)
+      {
+	mutex_lock(&h.take_lock);
+	example* ec = all.early_terminate ? nullptr : VW::get_example(p);
+	if (ec == nullptr)
+	  {
+	    bool done = all.early_terminate || parser_done(p);
+	    mutex_unlock(&h.take_lock);
+	    if (done)
+	      break;
+	  }
+	else if (ec->indices.size() <= 1 && (ec->end_pass || is_save_example(*ec)))
+	  {
+	    wait_for_finished(p, p->used_index - 1);
+	    if (ec->end_pass)
+	      {
+		all.l->end_pass();
+		VW::finish_example(all, ec);
+	      }
+	    else
+	      save_state(all, ec);
+	    mutex_unlock(&h.take_lock);
+	  }
+	else
+	  {
+	    mutex_unlock(&h.take_lock);
+	    if (ec->test_only || !all.training)
+	      all.l->predict(*ec);
+	    else
+	      all.l->learn(*ec);
+	    mutex_lock(&h.finish_lock);
+	    all.l->finish_example(all, *ec);
+	    mutex_unlock(&h.finish_lock);
+	  }
+      }
+#ifndef _WIN32
+    return nullptr;
+#else
+    return 0L;
+#endif
+  }
+
+  void hogwild_driver(vw& all)
+  {
+    hogwild h;
+    h.all = &all;
+    initialize_mutex(&h.take_lock);
+    initialize_mutex(&h.finish_lock);
+#ifndef _WIN32
+    h.threads = calloc_or_die<pthread_t>(all.learner_threads);
+    for (size_t i = 0; i < all.learner_threads; i++)
+      pthread_create(&h.threads[i], nullptr, hogwild_loop, &h);
+    for (size_t i = 0; i < all.learner_threads; i++)
+      pthread_join(h.threads[i], nullptr);
+#else
+    h.threads = calloc_or_die<HANDLE>(all.learner_threads);
+    for (size_t i = 0; i < all.learner_threads; i++)
+      h.threads[i] = ::CreateThread(nullptr, 0, static_cast<LPTHREAD_START_ROUTINE>(hogwild_loop), &h, 0L, nullptr);
+    for (size_t i = 0; i < all.learner_threads; i++)
+      {
+	::WaitForSingleObject(h.threads[i], INFINITE);
+	::CloseHandle(h.threads[i]);
+      }
+#endif
+    free(h.threads);
+    delete_mutex(&h.take_lock);
+    delete_mutex(&h.finish_lock);
+    all.l->end_examples();
+  }
+
   void generic_driver(vw& all)
   {
     example* ec = nullptr;
 
     all.l->init_driver();
+    if (all.learner_threads > 1)
+      return hogwild_driver(all);
+    pin_thread(all);
     while ( all.early_terminate == false )
       {
 	if ((ec = VW::get_example(all.p)) != nullptr)//semiblocking operation.
@@ -29,20 +163,8 @@ namespace LEARNER
 		all.l->end_pass();
 		VW::finish_example(all, ec);
 	      }
-	    else if (ec->tag.size() >= 4 && !strncmp((const char*) ec->tag.begin, "save", 4))
-	      {// save state command
-
-		string final_regressor_name = all.final_regressor_name;
-		
-		if ((ec->tag).size() >= 6 && (ec->tag)[4] == '_')
-		  final_regressor_name = string(ec->tag.begin+5, (ec->tag).size()-5);
-		
-		if (!all.quiet)
-		  cerr << "saving regressor to " << final_regressor_name << endl;
-		save_predictor(all, final_regressor_name, 0);
-		
-		VW::finish_example(all,ec);
-	      }
+	    else if (is_save_example(*ec))// save state command
+	      save_state(all, ec);
 	    else // empty example
 	      dispatch_example(all, *ec);
 	  }
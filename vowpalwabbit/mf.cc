@@ -132,7 +132,8 @@ void learn(mf& data, base_learner& base, example& ec) {
       for (size_t k = 1; k <= data.rank; k++) {
 
 	// multiply features in left namespace by r^k * x_r
-	for (feature* f = ec.atomics[left_ns].begin; f != ec.atomics[left_ns].end; f++)
+	v_array<feature>& features = ec.atomics[left_ns];
+	for (feature* f = features.begin; f != features.end; f++)
 	  f->x *= data.sub_predictions[2*k];
 
 	// update l^k using base learner
@@ -156,7 +157,8 @@ void learn(mf& data, base_learner& base, example& ec) {
       for (size_t k = 1; k <= data.rank; k++) {
 
 	// multiply features in right namespace by l^k * x_l
-	for (feature* f = ec.atomics[right_ns].begin; f != ec.atomics[right_ns].end; f++)
+	v_array<feature>& features = ec.atomics[right_ns];
+	for (feature* f = features.begin; f != features.end; f++)
 	  f->x *= data.sub_predictions[2*k-1];
 
 	// update r^k using base learner
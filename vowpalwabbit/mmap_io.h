@@ -0,0 +1,161 @@
+/*
+Copyright (c) by respective owners including Yahoo!, Microsoft, and
+individual contributors. All rights reserved.  Released under a BSD
+license as described in the file LICENSE.
+ */
+#pragma once
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "io_buf.h"
+
+// Reads regular files through a private memory mapping.  While a mapped file
+// is being read, space aliases the mapping, so buf_read and readto hand out
+// pointers into the page cache instead of copying into a growing buffer.
+// Anything that can't be mapped (pipes, sockets, empty files) goes through
+// the normal read() path.
+class mmap_io_buf : public io_buf
+{
+ public:
+  struct mapping {
+    int fd;
+    char* begin;
+    size_t size; // of the file, mapped with one more zero byte after it
+    bool streaming; // being read with read() instead, e.g. after a partial line from another file
+  };
+
+  v_array<mapping> maps;
+  v_array<char> owned; // the real buffer, while space aliases a mapping
+  int window; // fd whose mapping space aliases, or -1
+
+  mmap_io_buf() { maps = v_init<mapping>(); window = -1; }
+
+  virtual ~mmap_io_buf() {
+    while (maps.size() > 0)
+      unmap(maps.last().fd);
+    maps.delete_v();
+  }
+
+  mapping* find_mapping(int f) {
+    for (mapping* m = maps.begin; m != maps.end; m++)
+      if (m->fd == f)
+	return m;
+    return nullptr;
+  }
+
+  // go back to the owned buffer, keeping any unread bytes of the window
+  void use_owned_space() {
+    if (window == -1)
+      return;
+    char* unread = space.end;
+    size_t left = endloaded - space.end;
+    space = owned;
+    if (space.end_array - space.begin < (ptrdiff_t)left)
+      space.resize(left);
+    memcpy(space.begin, unread, left);
+    space.end = space.begin;
+    endloaded = space.begin + left;
+    window = -1;
+  }
+
+  void unmap(int f) {
+    mapping* m = find_mapping(f);
+    if (m == nullptr)
+      return;
+    if (window == f)
+      {
+	endloaded = space.end; // the bytes are going away with the mapping
+	use_owned_space();
+      }
+    munmap(m->begin, m->size + 1);
+    *m = maps.last();
+    maps.pop();
+  }
+
+  virtual int open_file(const char* name, bool stdin_off, int flag=READ) {
+    int ret = io_buf::open_file(name, stdin_off, flag);
+    if (ret == -1 || flag != READ)
+      return ret;
+
+    unmap(ret); // the descriptor may have been closed behind our back and reused
+    struct stat st;
+    if (fstat(ret, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+      return ret;
+    // private and writable so that parsing in place can never reach the file.
+    // The tokenizers look one byte past the end of a line, so the file is
+    // mapped over a zeroed region one byte longer: a last line without a
+    // newline then ends in a 0 even when the file fills its last page.
+    size_t bytes = (size_t)st.st_size + 1;
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+      return ret;
+    if (mmap(p, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, ret, 0) == MAP_FAILED)
+      {
+	munmap(p, bytes);
+	return ret;
+      }
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    madvise(p, st.st_size, MADV_WILLNEED);
+    mapping m = {ret, (char*)p, (size_t)st.st_size, false};
+    maps.push_back(m);
+    return ret;
+  }
+
+  virtual void reset_file(int f) {
+    if (window == f)
+      use_owned_space();
+    mapping* m = find_mapping(f);
+    if (m != nullptr)
+      m->streaming = false;
+    io_buf::reset_file(f);
+  }
+
+  virtual int64_t seek_file(int f, int64_t offset, int whence) {
+    if (window == f)
+      use_owned_space();
+    mapping* m = find_mapping(f);
+    if (m != nullptr)
+      m->streaming = false;
+    return io_buf::seek_file(f, offset, whence);
+  }
+
+  virtual size_t fill(int f) {
+    if (window == f)
+      return 0; // the whole file is already loaded
+
+    mapping* m = find_mapping(f);
+    if (m == nullptr || m->streaming || endloaded != space.end)
+      { // unread bytes have to be joined with the next ones, so copy
+	use_owned_space();
+	if (m != nullptr)
+	  m->streaming = true;
+	return io_buf::fill(f);
+      }
+
+    // start where read() left off (e.g. after the cache header)
+    off_t offset = lseek(f, 0, SEEK_CUR);
+    if (offset < 0 || (size_t)offset >= m->size)
+      return 0;
+    lseek(f, 0, SEEK_END);
+    if (window == -1)
+      owned = space;
+    space.begin = m->begin;
+    space.end = m->begin + offset;
+    space.end_array = m->begin + m->size;
+    endloaded = space.end_array;
+    window = f;
+    return m->size - offset;
+  }
+
+  virtual void shift_space() {
+    if (window == -1)
+      io_buf::shift_space();
+  }
+
+  virtual bool close_file() {
+    if (files.size() > 0)
+      unmap(files.last());
+    return io_buf::close_file();
+  }
+};
+#endif
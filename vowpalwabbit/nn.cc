@@ -95,7 +95,7 @@ struct nn {
     // TODO: not correct if --noconstant
     memset (&n.hiddenbias, 0, sizeof (n.hiddenbias));
     n.hiddenbias.indices.push_back(constant_namespace);
-    feature temp = {1,(uint32_t) constant};
+    feature temp = {1,(feature_index) constant};
     n.hiddenbias.atomics[constant_namespace].push_back(temp);
     n.hiddenbias.total_sum_feat_sq++;
     n.hiddenbias.l.simple.label = FLT_MAX;
@@ -7,9 +7,11 @@ license as described in the file LICENSE.
 #include <float.h>
 #include <sstream>
 #include <fstream>
+#include <thread>
 
 #include "parse_regressor.h"
 #include "parser.h"
+#include "placement.h"
 #include "vw.h"
 
 #include "sender.h"
@@ -128,7 +130,7 @@ void parse_dictionary_argument(vw&all, string str) {
 
     // clear up ec
     ec->tag.erase(); ec->indices.erase();
-    for (size_t i=0; i<256; i++) { ec->atomics[i].erase(); ec->audit_features[i].erase(); }
+    clear_namespaces(*ec);
   }
   dealloc_example(all.p->lp.delete_label, *ec);
   free(ec);
@@ -259,8 +261,11 @@ void parse_source(vw& all)
     ("cache,c", "Use a cache.  The default is <data>.cache")
     ("cache_file", po::value< vector<string> >(), "The location(s) of cache_file.")
     ("kill_cache,k", "do not reuse existing cache: create a new one always")
+    ("cache_skip", po::value<size_t>(&(all.p->cache_skip)), "start the first pass at this example of an existing cache, seeking to it with the cache's block index")
+    ("cache_in_memory", "keep the examples of the first pass in memory for the later passes, instead of re-reading the input")
     ("compressed", "use gzip format whenever possible. If a cache file is being created, this option creates a compressed cache file. A mixture of raw-text & compressed inputs are supported with autodetection.")
-    ("no_stdin", "do not default to reading from stdin");
+    ("no_stdin", "do not default to reading from stdin")
+    ("read_ahead", "read stdin, pipes and sockets on a separate thread, ahead of the parser");
   add_options(all);
 
   // Be friendly: if -d was left out, treat positional param as data file
@@ -277,6 +282,12 @@ void parse_source(vw& all)
   //begin input source
   if (vm.count("no_stdin"))
     all.stdin_off = true;
+
+  if (vm.count("read_ahead"))
+    all.p->read_ahead = true;
+
+  if (vm.count("cache_in_memory"))
+    all.p->cache_in_memory = true;
   
   if ( (vm.count("total") || vm.count("node") || vm.count("unique_id")) && !(vm.count("total") && vm.count("node") && vm.count("unique_id")) )
     {
@@ -318,6 +329,7 @@ void parse_feature_tweaks(vw& all)
 {
   new_options(all, "Feature options")
     ("hash", po::value< string > (), "how to hash the features. Available options: strings, all")
+    ("hash_cache", po::value<size_t>(&(all.p->hash_cache_bits)), "remember the hashes of up to 2^<arg> recent feature names in each parser thread")
     ("ignore", po::value< vector<unsigned char> >(), "ignore namespaces beginning with character <arg>")
     ("keep", po::value< vector<unsigned char> >(), "keep namespaces beginning with character <arg>")
     ("redefine", po::value< vector<string> >(), "redefine namespaces beginning with characters of string S as namespace N. <arg> shall be in form 'N:=S' where := is operator. Empty N or S are treated as default namespace. Use ':' as a wildcard in S.")
@@ -333,7 +345,10 @@ void parse_feature_tweaks(vw& all)
     ("quadratic,q", po::value< vector<string> > (), "Create and use quadratic features")
     ("q:", po::value< string >(), ": corresponds to a wildcard for all printable characters")
     ("cubic", po::value< vector<string> > (),
-     "Create and use cubic features");
+     "Create and use cubic features")
+    ("interactions", po::value< vector<string> > (), "Create and use interactions of any number of namespaces, e.g. abcd")
+    ("symmetric_interactions", "In interactions that repeat a namespace, as -q aa does, use each combination of its features once")
+    ("no_self_interactions", "Like --symmetric_interactions, and never cross a feature with itself");
   add_options(all);
 
   po::variables_map& vm = all.vm;
@@ -343,6 +358,8 @@ void parse_feature_tweaks(vw& all)
   if(vm.count("hash")) 
     hash_function = vm["hash"].as<string>();
   all.p->hasher = getHasher(hash_function);
+  if (all.p->hash_cache_bits > 0)
+    init_hash_cache(all.p->names, all.p->hash_cache_bits);
       
   if (vm.count("spelling")) {
     vector<string> spelling_ns = vm["spelling"].as< vector<string> >();
@@ -395,9 +412,14 @@ void parse_feature_tweaks(vw& all)
 	}
       all.default_bits = false;
       all.num_bits = new_bits;
-      if (all.num_bits > min(31, sizeof(size_t)*8 - 3))
+      size_t bits_limit = min((size_t)max_num_bits, sizeof(size_t)*8 - 3);
+      if (all.num_bits > bits_limit)
 	{
-	  cout << "Only " << min(31, sizeof(size_t)*8 - 3) << " or fewer bits allowed.  If this is a serious limit, speak up." << endl;
+	  cout << "Only " << bits_limit << " or fewer bits allowed.";
+#ifndef VW_64BIT_INDICES
+	  cout << "  Build with 64 bit feature indices (make INDEX64=1 or configure --enable-64bit-indices) for more.";
+#endif
+	  cout << endl;
 	  throw exception();
 	}
     }
@@ -490,6 +512,36 @@ void parse_feature_tweaks(vw& all)
 	}
     }
 
+  if (vm.count("interactions"))
+    {
+      vector<string> terms = vm["interactions"].as< vector<string> >();
+      if (!all.quiet)
+	cerr << "creating interactions: ";
+      for (vector<string>::iterator i = terms.begin(); i != terms.end();i++)
+	{
+	  if (i->length() < 2 || i->length() > 256)
+	    {
+	      cerr << endl << "error, interactions must involve from two to 256 sets: " << *i << endl;
+	      throw exception();
+	    }
+	  if (count(all.interactions.begin(), all.interactions.end(), *i) > 0)
+	    continue; // given again by a loaded model
+	  all.interactions.push_back(*i);
+	  *all.file_options << " --interactions " << *i;
+	  if (!all.quiet)
+	    cerr << *i << " ";
+	}
+      if (!all.quiet)
+	cerr << endl;
+    }
+
+  all.no_self_interactions = vm.count("no_self_interactions") > 0;
+  all.symmetric_interactions = all.no_self_interactions || vm.count("symmetric_interactions") > 0;
+  if (all.no_self_interactions)
+    *all.file_options << " --no_self_interactions";
+  else if (all.symmetric_interactions)
+    *all.file_options << " --symmetric_interactions";
+
   for (size_t i = 0; i < 256; i++)
     all.ignore[i] = false;
   all.ignore_some = false;
@@ -750,6 +802,9 @@ void parse_output_model(vw& all)
     ("readable_model", po::value< string >(), "Output human-readable final regressor with numeric features")
     ("invert_hash", po::value< string >(), "Output human-readable final regressor with feature names.  Computationally expensive.")
     ("save_resume", "save extra state so learning can be resumed later with new data")
+    ("mmap_model", "Save the weights as a page aligned array that loading the model maps instead of reading")
+    ("chunked_model", "Save the weights as compressed chunks that are encoded and decoded in parallel")
+    ("model_threads", po::value<size_t>(), "Threads saving or loading a --chunked_model, by default one per cpu")
     ("save_per_pass", "Save the model after every pass over data")
     ("output_feature_regularizer_binary", po::value< string >(&(all.per_feature_regularizer_output)), "Per feature regularization output file")
     ("output_feature_regularizer_text", po::value< string >(&(all.per_feature_regularizer_text)), "Per feature regularization output file, in text");  
@@ -777,6 +832,28 @@ void parse_output_model(vw& all)
 
   if (vm.count("save_resume"))
     all.save_resume = true;
+
+  if (vm.count("mmap_model"))
+    { // the weights are read the way they were written
+      all.mmap_model = true;
+      *all.file_options << " --mmap_model";
+    }
+
+  if (vm.count("chunked_model"))
+    {
+      all.chunked_model = true;
+      *all.file_options << " --chunked_model";
+      if (all.mmap_model)
+	{
+	  cerr << "error: --chunked_model can not be used with --mmap_model" << endl;
+	  throw exception();
+	}
+    }
+
+  if (vm.count("model_threads"))
+    all.model_threads = vm["model_threads"].as<size_t>();
+  else
+    all.model_threads = max(thread::hardware_concurrency(), 1u);
 }
 
 void load_input_model(vw& all, io_buf& io_temp)
@@ -807,8 +884,8 @@ LEARNER::base_learner* setup_base(vw& all)
   LEARNER::base_learner* ret = all.reduction_stack.pop()(all);
   if (ret == nullptr)
     return setup_base(all);
-  else 
-    return ret;
+  all.stack_depth++;
+  return ret;
 }
 
 void parse_reductions(vw& all)
@@ -852,6 +929,20 @@ void parse_reductions(vw& all)
   all.reduction_stack.push_back(bs_setup);
 
   all.l = setup_base(all);
+
+  if (all.learner_threads > 1)
+    { // reductions and the other base learners keep scratch state per example
+      if (all.stack_depth != 2 || all.reduction_stack.size() != 0)
+	{
+	  cerr << "error: --learner_threads only works with plain gradient descent, without reductions" << endl;
+	  throw exception();
+	}
+      if (all.reg_mode || all.audit || all.hash_inv)
+	{
+	  cerr << "error: --learner_threads can not be used with --l1, --l2, --audit or --invert_hash" << endl;
+	  throw exception();
+	}
+    }
 }
 
 void add_to_args(vw& all, int argc, char* argv[])
@@ -873,7 +964,9 @@ vw& parse_args(int argc, char *argv[])
 
   new_options(all, "VW options")
     ("random_seed", po::value<size_t>(&random_seed), "seed random number generator")
-    ("ring_size", po::value<size_t>(&(all.p->ring_size)), "size of example ring");
+    ("ring_size", po::value<size_t>(&(all.p->ring_size)), "size of example ring")
+    ("parser_threads", po::value<size_t>(&(all.p->parse_threads)), "number of threads parsing text examples in parallel")
+    ("learner_threads", po::value<size_t>(&(all.learner_threads)), "number of threads learning in parallel on shared weights without locks");
   add_options(all);
 
   new_options(all, "Update options")
@@ -889,7 +982,10 @@ vw& parse_args(int argc, char *argv[])
     ("initial_regressor,i", po::value< vector<string> >(), "Initial regressor(s)")
     ("initial_weight", po::value<float>(&(all.initial_weight)), "Set all weights to an initial value of arg.")
     ("random_weights", po::value<bool>(&(all.random_weights)), "make initial weights random")
-    ("input_feature_regularizer", po::value< string >(&(all.per_feature_regularizer_input)), "Per feature regularization input file");
+    ("input_feature_regularizer", po::value< string >(&(all.per_feature_regularizer_input)), "Per feature regularization input file")
+    ("huge_pages", po::value< string >(), "Back the weights with huge pages: transparent or explicit (reserved in /proc/sys/vm/nr_hugepages)")
+    ("numa", po::value< string >(), "Place the weights on NUMA nodes: interleave, or the number of a node to bind them to")
+    ("pin_threads", "Pin the parse and learner threads to cpus of their own");
   add_options(all);
 
   new_options(all, "Parallelization options")
@@ -935,6 +1031,10 @@ vw& parse_args(int argc, char *argv[])
   
   parse_output_preds(all);
 
+  all.pin_threads = vm.count("pin_threads") > 0;
+  parse_placement(all, vm.count("huge_pages") ? vm["huge_pages"].as<string>() : "",
+		  vm.count("numa") ? vm["numa"].as<string>() : "");
+
   parse_reductions(all);
 
   if (!all.quiet)
@@ -1074,14 +1174,18 @@ namespace VW {
         cerr << endl << "total feature number = " << all.sd->total_features;
         if (all.sd->queries > 0)
 	  cerr << endl << "total queries = " << all.sd->queries << endl;
+        if (all.p->names.lookups > 0)
+	  cerr << endl << "hash cache hits = " << all.p->names.hits << " of " << all.p->names.lookups
+	       << " (" << 100. * all.p->names.hits / all.p->names.lookups << "%)";
         cerr << endl;
         }
     
     finalize_regressor(all, all.final_regressor_name);
     all.l->finish();
     free_it(all.l);
-    if (all.reg.weight_vector != nullptr)
-      free(all.reg.weight_vector);
+    free_weights(all);
+    if (all.reg.dirty_rows != nullptr)
+      free_weights((weight*)all.reg.dirty_rows, all.dirty_bytes_mapped);
     free_parser(all);
     finalize_source(all.p);
     all.p->parse_name.erase();
@@ -14,15 +14,6 @@ license as described in the file LICENSE.
 
 using namespace std;
 
-char* copy(char* base)
-{
-  size_t len = 0;
-  while (base[len++] != '\0');
-  char* ret = calloc_or_die<char>(len);
-  memcpy(ret,base,len);
-  return ret;
-}
-
 template<bool audit>
 class TC_parser {
   
@@ -36,6 +27,8 @@ public:
   size_t channel_hash;
   char* base;
   unsigned char index;
+  v_array<feature>* features; // ae->atomics[index], looked up once per namespace
+  float* sum_feat_sq;
   float v;
   bool redefine_some;
   unsigned char (*redefine)[256];
@@ -76,8 +69,7 @@ public:
   inline substring read_name(){
     substring ret;
     ret.begin = reading_head;
-    while( !(*reading_head == ' ' || *reading_head == ':' || *reading_head == '\t' || *reading_head == '|' || reading_head == endLine || *reading_head == '\r' ))
-      ++reading_head;
+    reading_head = next_delimiter(reading_head, endLine);
     ret.end = reading_head;
 
     return ret;
@@ -92,18 +84,16 @@ public:
       v = cur_channel_v * featureValue();
       size_t word_hash;
       if (feature_name.end != feature_name.begin)
-	word_hash = (p->hasher(feature_name,(uint32_t)channel_hash));
+	word_hash = cached_hash(p->names, p->hasher, feature_name, (uint32_t)channel_hash);
       else
 	word_hash = channel_hash + anon++;
       if(v == 0) return; //dont add 0 valued features to list of features
-      feature f = {v,(uint32_t)word_hash };
-      ae->sum_feat_sq[index] += v*v;
-      ae->atomics[index].push_back(f);
+      feature f = {v,(feature_index)word_hash };
+      *sum_feat_sq += v*v;
+      features->push_back(f);
       if(audit){
-	v_array<char> feature_v = v_init<char>();
-	push_many(feature_v, feature_name.begin, feature_name.end - feature_name.begin);
-	feature_v.push_back('\0');
-	audit_data ad = {copy(base),feature_v.begin,word_hash,v,true};
+	char* feature = arena_copy(ae->audit_strings, feature_name.begin, feature_name.end - feature_name.begin);
+	audit_data ad = {base,feature,word_hash,v,false};
 	ae->audit_features[index].push_back(ad);
       }
       if ((affix_features[index] > 0) && (feature_name.end != feature_name.begin)) {
@@ -120,19 +110,20 @@ public:
             else
               affix_name.begin = affix_name.end - len;
           }
-          word_hash = p->hasher(affix_name,(uint32_t)channel_hash) * (affix_constant + (affix & 0xF) * quadratic_constant);
-          feature f2 = { v, (uint32_t) word_hash };
+          word_hash = cached_hash(p->names, p->hasher, affix_name, (uint32_t)channel_hash) * (affix_constant + (affix & 0xF) * quadratic_constant);
+          feature f2 = { v, (feature_index) word_hash };
           ae->sum_feat_sq[affix_namespace] += v*v;
           ae->atomics[affix_namespace].push_back(f2);
           if (audit) {
-            v_array<char> affix_v = v_init<char>();
-            if (index != ' ') affix_v.push_back(index);
-            affix_v.push_back(is_prefix ? '+' : '-');
-            affix_v.push_back('0' + len);
-            affix_v.push_back('=');
-            push_many(affix_v, affix_name.begin, affix_name.end - affix_name.begin);
-            affix_v.push_back('\0');
-            audit_data ad = {copy((char*)"affix"),affix_v.begin,word_hash,v,true};
+            char* affix_v = arena_alloc(ae->audit_strings, 4 + (affix_name.end - affix_name.begin) + 1);
+            char* c = affix_v;
+            if (index != ' ') *(c++) = index;
+            *(c++) = is_prefix ? '+' : '-';
+            *(c++) = '0' + len;
+            *(c++) = '=';
+            for (char* fc = affix_name.begin; fc != affix_name.end; ++fc) *(c++) = *fc;
+            *c = '\0';
+            audit_data ad = {(char*)"affix",affix_v,word_hash,v,false};
             ae->audit_features[affix_namespace].push_back(ad);
           }
           
@@ -143,7 +134,7 @@ public:
         if (ae->atomics[spelling_namespace].size() == 0)
           ae->indices.push_back(spelling_namespace);
         //v_array<char> spelling;
-        spelling.erase();
+        spelling.clear();
         for (char*c = feature_name.begin; c!=feature_name.end; ++c) {
           char d = 0;
           if      ((*c >= '0') && (*c <= '9')) d = '0';
@@ -156,15 +147,16 @@ public:
         }
         substring spelling_ss = { spelling.begin, spelling.end };
         size_t word_hash = hashstring(spelling_ss, (uint32_t)channel_hash);
-        feature f2 = { v, (uint32_t) word_hash };
+        feature f2 = { v, (feature_index) word_hash };
         ae->sum_feat_sq[spelling_namespace] += v*v;
         ae->atomics[spelling_namespace].push_back(f2);
         if (audit) {
-          v_array<char> spelling_v = v_init<char>();
-          if (index != ' ') { spelling_v.push_back(index); spelling_v.push_back('_'); }
-          push_many(spelling_v, spelling_ss.begin, spelling_ss.end - spelling_ss.begin);
-          spelling_v.push_back('\0');
-          audit_data ad = {copy((char*)"spelling"),spelling_v.begin,word_hash,v,true};
+          char* spelling_v = arena_alloc(ae->audit_strings, 2 + spelling.size() + 1);
+          char* c = spelling_v;
+          if (index != ' ') { *(c++) = index; *(c++) = '_'; }
+          memcpy(c, spelling.begin, spelling.size());
+          c[spelling.size()] = '\0';
+          audit_data ad = {(char*)"spelling",spelling_v,word_hash,v,false};
           ae->audit_features[spelling_namespace].push_back(ad);
         }
       }
@@ -172,7 +164,7 @@ public:
         for (size_t dict=0; dict<namespace_dictionaries[index].size(); dict++) {
           feature_dict* map = namespace_dictionaries[index][dict];
           uint32_t hash = uniform_hash(feature_name.begin, feature_name.end-feature_name.begin, quadratic_constant);
-          v_array<feature>* feats = map->get(feature_name, hash);
+          v_array<feature>* feats = map->find(feature_name, hash);
           if ((feats != nullptr) && (feats->size() > 0)) {
             if (ae->atomics[dictionary_namespace].size() == 0)
               ae->indices.push_back(dictionary_namespace);
@@ -181,16 +173,16 @@ public:
               ae->sum_feat_sq[dictionary_namespace] += f->x * f->x;
             if (audit) {
               for (feature*f = feats->begin; f != feats->end; ++f) {
-                uint32_t id = f->weight_index;
-                size_t len = 2 + (feature_name.end-feature_name.begin) + 1 + (size_t)ceil(log10(id)) + 1;
-                char* str = calloc_or_die<char>(len);
+                unsigned long long id = f->weight_index;
+                size_t len = 2 + (feature_name.end-feature_name.begin) + 1 + 20 + 1;
+                char* str = arena_alloc(ae->audit_strings, len);
                 str[0] = index;
                 str[1] = '_';
                 char *c = str+2;
                 for (char* fc=feature_name.begin; fc!=feature_name.end; ++fc) *(c++) = *fc;
                 *(c++) = '=';
-                sprintf(c, "%d", id);
-                audit_data ad = { copy((char*)"dictionary"), str, f->weight_index, f->x, true };
+                sprintf(c, "%llu", id);
+                audit_data ad = { (char*)"dictionary", str, f->weight_index, f->x, false };
                 ae->audit_features[dictionary_namespace].push_back(ad);
               }
             }
@@ -222,6 +214,13 @@ public:
     }
   }
   
+  inline void open_namespace(){
+    features = &ae->atomics[index];
+    sum_feat_sq = &ae->sum_feat_sq[index];
+    if(features->begin == features->end)
+      new_index = true;
+  }
+
   inline void nameSpaceInfo(){
     if(reading_head == endLine ||*reading_head == '|' || *reading_head == ' ' || *reading_head == '\t' || *reading_head == ':' || *reading_head == '\r'){
       // syntax error
@@ -230,18 +229,11 @@ public:
       // NameSpaceInfo --> 'String' NameSpaceInfoValue
       index = (unsigned char)(*reading_head);
       if (redefine_some) index = (*redefine)[index]; //redefine index
-      if(ae->atomics[index].begin == ae->atomics[index].end)
-	new_index = true;
+      open_namespace();
       substring name = read_name();
-      if(audit){
-	v_array<char> base_v_array = v_init<char>();
-	push_many(base_v_array, name.begin, name.end - name.begin);
-	base_v_array.push_back('\0');
-	if (base != nullptr)
-	  free(base);
-	base = base_v_array.begin;
-      }
-      channel_hash = p->hasher(name, hash_base);
+      if(audit)
+	base = arena_copy(ae->audit_strings, name.begin, name.end - name.begin);
+      channel_hash = cached_hash(p->names, p->hasher, name, hash_base);
       nameSpaceInfoValue();
     }
   }
@@ -266,16 +258,9 @@ public:
     if(*reading_head == ' ' || *reading_head == '\t' || reading_head == endLine || *reading_head == '|' || *reading_head == '\r' ){
       // NameSpace --> ListFeatures
       index = (unsigned char)' ';
-      if(ae->atomics[index].begin == ae->atomics[index].end)
-	new_index = true;
+      open_namespace();
       if(audit)
-	{
-	  if (base != nullptr)
-	    free(base);
-	  base = calloc_or_die<char>(2);
-	  base[0] = ' ';
-	  base[1] = '\0';
-	}
+	base = (char*)" ";
       channel_hash = 0;
       listFeatures();
     }else if(*reading_head != ':'){
@@ -286,7 +271,7 @@ public:
       // syntax error
       cout << "malformed example !\n'|' , String, space or EOL expected after : \"" << std::string(beginLine, reading_head - beginLine).c_str()<< "\"" << endl;
     }
-    if(new_index && ae->atomics[index].begin != ae->atomics[index].end)
+    if(new_index && features->begin != features->end)
       ae->indices.push_back(index);
   }
   
@@ -302,14 +287,14 @@ public:
       }
   }
 
-  TC_parser(char* reading_head, char* endLine, vw& all, example* ae){
+  TC_parser(char* reading_head, char* endLine, vw& all, parser* p, example* ae){
     spelling = v_init<char>();
     if (endLine != reading_head)
       {
 	this->beginLine = reading_head;
 	this->reading_head = reading_head;
 	this->endLine = endLine;
-	this->p = all.p;
+	this->p = p;
 	this->redefine_some = all.redefine_some;
 	this->redefine = &all.redefine;
 	this->ae = ae;
@@ -318,15 +303,13 @@ public:
 	this->namespace_dictionaries = all.namespace_dictionaries;
 	this->base = nullptr;
 	listNameSpace();
-	if (base != nullptr)
-	  free(base);
       }
   }
 };
 
-void substring_to_example(vw* all, example* ae, substring example)
+void substring_to_example(vw* all, parser* p, example* ae, substring example)
 {
-  all->p->lp.default_label(&ae->l);
+  p->lp.default_label(&ae->l);
   char* bar_location = safe_index(example.begin, '|', example.end);
   char* tab_location = safe_index(example.begin, '\t', bar_location);
   substring label_space;
@@ -338,36 +321,29 @@ void substring_to_example(vw* all, example* ae, substring example)
   label_space.end = bar_location;
   
   if (*example.begin == '|')	{
-    all->p->words.erase();
+    p->words.clear();
   } else 	{
-    tokenize(' ', label_space, all->p->words);
-    if (all->p->words.size() > 0 && (all->p->words.last().end == label_space.end	|| *(all->p->words.last().begin) == '\'')) //The last field is a tag, so record and strip it off
+    tokenize(' ', label_space, p->words);
+    if (p->words.size() > 0 && (p->words.last().end == label_space.end	|| *(p->words.last().begin) == '\'')) //The last field is a tag, so record and strip it off
       {
-	substring tag = all->p->words.pop();
+	substring tag = p->words.pop();
 	if (*tag.begin == '\'')
 	  tag.begin++;
 	push_many(ae->tag, tag.begin, tag.end - tag.begin);
       }
   }
 
-  if (all->p->words.size() > 0)
-    all->p->lp.parse_label(all->p, all->sd, &ae->l, all->p->words);
+  if (p->words.size() > 0)
+    p->lp.parse_label(p, all->sd, &ae->l, p->words);
   
   if (all->audit || all->hash_inv)
-    TC_parser<true> parser_line(bar_location,example.end,*all,ae);
+    TC_parser<true> parser_line(bar_location,example.end,*all,p,ae);
   else
-    TC_parser<false> parser_line(bar_location,example.end,*all,ae);
+    TC_parser<false> parser_line(bar_location,example.end,*all,p,ae);
 }
 
-int read_features(void* in, example* ex)
+void read_text_line(vw* all, parser* p, example* ae, char* line, size_t num_chars)
 {
-  vw* all = (vw*)in;
-  example* ae = (example*)ex;
-  char *line=nullptr;
-  size_t num_chars_initial = readto(*(all->p->input), line, '\n');
-  if (num_chars_initial < 1)
-    return (int)num_chars_initial;
-  size_t num_chars = num_chars_initial;
   if (line[0] =='\xef' && num_chars >= 3 && line[1] == '\xbb' && line[2] == '\xbf') {
     line += 3;
     num_chars -= 3;
@@ -377,7 +353,18 @@ int read_features(void* in, example* ex)
   if (line[num_chars-1] == '\r')
     num_chars--;
   substring example = {line, line + num_chars};
-  substring_to_example(all, ae, example);
+  substring_to_example(all, p, ae, example);
+}
+
+int read_features(void* in, example* ex)
+{
+  vw* all = (vw*)in;
+  example* ae = (example*)ex;
+  char *line=nullptr;
+  size_t num_chars_initial = readto(*(all->p->input), line, '\n');
+  if (num_chars_initial < 1)
+    return (int)num_chars_initial;
+  read_text_line(all, all->p, ae, line, num_chars_initial);
 
   return (int)num_chars_initial;
 }
@@ -386,5 +373,5 @@ void read_line(vw& all, example* ex, char* line)
 {
   substring ss = {line, line+strlen(line)};
   while ((ss.end >= ss.begin) && (*(ss.end-1) == '\n')) ss.end--;
-  substring_to_example(&all, ex, ss);  
+  substring_to_example(&all, all.p, ex, ss);  
 }
@@ -8,7 +8,10 @@ license as described in the file LICENSE.
 #include "parse_primitives.h"
 #include "example.h"
 
+struct parser;
+
 //example processing
 
 int read_features(void* a, example* ex);// read example from  preset buffers.
 void read_line(vw& all, example* ex, char* line);//read example from the line.
+void read_text_line(vw* all, parser* p, example* ex, char* line, size_t num_chars);//parse one input line using p's scratch buffers.
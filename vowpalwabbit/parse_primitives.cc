@@ -11,9 +11,12 @@ license as described in the file LICENSE.
 #include "parse_primitives.h"
 #include "hash.h"
 
+const double parse_float_powers[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+				       1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
 void tokenize(char delim, substring s, v_array<substring>& ret, bool allow_empty)
 {
-  ret.erase();
+  ret.clear();
   char *last = s.begin;
   for (; s.begin != s.end; s.begin++) {
     if (*s.begin == delim) {
@@ -32,6 +35,19 @@ void tokenize(char delim, substring s, v_array<substring>& ret, bool allow_empty
     }
 }
 
+#ifdef VW_64BIT_INDICES
+// With 64 bit indices a second hash of the string fills the high half, so
+// the low one, and the models of -b 32 or less, are those of a 32 bit build.
+static inline size_t string_hash(substring s, uint32_t h)
+{
+  size_t high = uniform_hash((unsigned char *)s.begin, s.end - s.begin, h ^ 0x5bd1e995);
+  return (high << 32) | uniform_hash((unsigned char *)s.begin, s.end - s.begin, h);
+}
+#else
+static inline size_t string_hash(substring s, uint32_t h)
+{ return uniform_hash((unsigned char *)s.begin, s.end - s.begin, h); }
+#endif
+
 size_t hashstring (substring s, uint32_t h)
 {
   //trim leading whitespace but not UTF-8
@@ -45,13 +61,13 @@ size_t hashstring (substring s, uint32_t h)
     if (*p >= '0' && *p <= '9')
       ret = 10*ret + *(p++) - '0';
     else
-      return uniform_hash((unsigned char *)s.begin, s.end - s.begin, h);
+      return string_hash(s, h);
 
   return ret + h;
 }
 
 size_t hashall (substring s, uint32_t h)
-{ return uniform_hash((unsigned char *)s.begin, s.end - s.begin, h); }
+{ return string_hash(s, h); }
 
 hash_func_t getHasher(const std::string& s){
   if (s=="strings")
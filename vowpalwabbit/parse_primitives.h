@@ -9,9 +9,15 @@ license as described in the file LICENSE.
 #include <math.h>
 #include "v_array.h"
 
+#if !defined(VW_NO_INLINE_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define VW_TOKENIZE_SSE2
+#endif
+
 #ifdef _WIN32
 #include <WinSock2.h>
 #include <Windows.h>
+#include <intrin.h>
 typedef CRITICAL_SECTION MUTEX;
 typedef CONDITION_VARIABLE CV;
 #else
@@ -19,6 +25,16 @@ typedef pthread_mutex_t MUTEX;
 typedef pthread_cond_t CV;
 #endif
 
+// thin wrappers over pthreads and the Windows equivalents, see parser.cc
+void initialize_mutex(MUTEX* pm);
+void delete_mutex(MUTEX* pm);
+void initialize_condition_variable(CV* pcv);
+void mutex_lock(MUTEX* pm);
+void mutex_unlock(MUTEX* pm);
+void condition_variable_wait(CV* pcv, MUTEX* pm);
+void condition_variable_signal(CV* pcv);
+void condition_variable_signal_all(CV* pcv);
+
 struct substring {
   char *begin;
   char *end;
@@ -27,6 +43,40 @@ struct substring {
 //chop up the string into a v_array of substring.
 void tokenize(char delim, substring s, v_array<substring> &ret, bool allow_empty=false);
 
+inline bool is_delimiter(char c)
+{ return c == ' ' || c == '\t' || c == ':' || c == '|' || c == '\r'; }
+
+// The first byte at or after p delimiting names and values in the text
+// format (' ', '\t', ':', '|' or '\r'), or end.  Compares 16 bytes at a time
+// with SSE2 while that many are left.
+inline char* next_delimiter(char* p, char* end)
+{
+#ifdef VW_TOKENIZE_SSE2
+  const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), colon = _mm_set1_epi8(':');
+  const __m128i bar = _mm_set1_epi8('|'), cr = _mm_set1_epi8('\r');
+  for (; end - p >= 16; p += 16)
+    {
+      __m128i v = _mm_loadu_si128((__m128i*)p);
+      __m128i d = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+			       _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, bar)));
+      int mask = _mm_movemask_epi8(_mm_or_si128(d, _mm_cmpeq_epi8(v, cr)));
+      if (mask != 0)
+	{
+#ifdef _WIN32
+	  unsigned long bit;
+	  _BitScanForward(&bit, mask);
+	  return p + bit;
+#else
+	  return p + __builtin_ctz(mask);
+#endif
+	}
+    }
+#endif
+  while (p != end && !is_delimiter(*p))
+    p++;
+  return p;
+}
+
 inline char* safe_index(char *start, char v, char *max)
 {
   while (start != max && *start != v)
@@ -50,6 +100,11 @@ hash_func_t getHasher(const std::string& s);
 //  - much faster (around 50% but depends on the string to parse)
 //  - less error control, but utilised inside a very strict parser
 //    in charge of error detection.
+// While the digits fit in 53 bits and the decimal exponent is at most 22
+// in size, the integer and the power of ten are exact doubles, so the one
+// multiply or divide is correctly rounded; anything else goes to strtof.
+extern const double parse_float_powers[23];
+
 inline float parseFloat(char * p, char **end)
 {
   char* start = p;
@@ -66,41 +121,63 @@ inline float parseFloat(char * p, char **end)
     s = -1; p++;
   }
   
-  float acc = 0;
-  while (*p >= '0' && *p <= '9')
-    acc = acc * 10 + *p++ - '0';
+  uint64_t acc = 0;
+  int digits = 0; // significant ones in acc
+  int exp_acc = 0;
+  while (*p >= '0' && *p <= '9') {
+    if (digits < 19) {
+      acc = acc * 10 + (*p - '0');
+      digits += acc != 0;
+    }
+    else
+      exp_acc++, digits++;
+    p++;
+  }
 
-  int num_dec = 0;
   if (*p == '.') {
     while (*(++p) >= '0' && *p <= '9') {
-      if (num_dec < 35)
-	{
-	  acc = acc *10 + (*p - '0');
-	  num_dec++;
-	}
+      if (digits < 19) {
+	acc = acc * 10 + (*p - '0');
+	digits += acc != 0;
+	exp_acc--;
+      }
+      else
+	digits++;
     }
   }
 
-  int exp_acc = 0;
   if(*p == 'e' || *p == 'E'){
     p++;
     int exp_s = 1;
     if (*p == '-') {
       exp_s = -1; p++;
     }
-    while (*p >= '0' && *p <= '9')
-      exp_acc = exp_acc * 10 + *p++ - '0';
-    exp_acc *= exp_s;
-    
+    else if (*p == '+')
+      p++;
+    int e = 0;
+    while (*p >= '0' && *p <= '9') {
+      if (e < 10000)
+	e = e * 10 + *p - '0';
+      p++;
+    }
+    exp_acc += exp_s * e;
   }
-  if (*p == ' ' || *p == '\n' || *p == '\t')//easy case succeeded.
+  if ((*p == ' ' || *p == '\n' || *p == '\t') && digits <= 19 && acc <= (1ULL << 53) && exp_acc >= -22 && exp_acc <= 22)//easy case succeeded.
     {
-      acc *= powf(10,(float)(exp_acc-num_dec));
-      *end = p;
-      return s * acc;
+      double d = (double)acc;
+      if (exp_acc < 0)
+	d /= parse_float_powers[-exp_acc];
+      else
+	d *= parse_float_powers[exp_acc];
+      uint64_t bits;
+      memcpy(&bits, &d, sizeof(bits));
+      if ((bits & 0x1FFFFFFF) != 0x10000000) // unless d is halfway between two floats, rounding it again is exact
+	{
+	  *end = p;
+	  return (float)(s * d);
+	}
     }
-  else
-    return (float)strtod(start,end);
+  return strtof(start,end);
 }
 
 inline bool nanpattern( float value ) { return ((*(uint32_t*)&value) & 0x7fC00000) == 0x7fC00000; } 
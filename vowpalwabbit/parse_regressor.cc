@@ -14,9 +14,12 @@ using namespace std;
 #include <stdint.h>
 #include <math.h>
 #include <algorithm>
+#include <random>
 
 #include "rand48.h"
 #include "global_data.h"
+#include "placement.h"
+#include "hash.h"
 
 /* Define the last version where files are backward compatible. */
 #define LAST_COMPATIBLE_VERSION "6.1.3"
@@ -31,12 +34,21 @@ void initialize_regressor(vw& all)
 
   size_t length = ((size_t)1) << all.num_bits;
   all.reg.weight_mask = (length << all.reg.stride_shift) - 1;
-  all.reg.weight_vector = calloc_or_die<weight>(length << all.reg.stride_shift);
+  all.reg.weight_vector = allocate_weights(all, length << all.reg.stride_shift, false, all.weight_bytes_mapped);
   if (all.reg.weight_vector == nullptr)
     {
       cerr << all.program_name << ": Failed to allocate weight array with " << all.num_bits << " bits: try decreasing -b <bits>" << endl;
       throw exception();
-    } else
+    }
+  if (all.reg.state_stride > 0)
+    {
+      all.reg.state_vector = allocate_weights(all, length * all.reg.state_stride + 1, false, all.state_bytes_mapped);
+      if (all.reg.state_vector == nullptr)
+	{
+	  cerr << all.program_name << ": Failed to allocate the update state with " << all.num_bits << " bits: try decreasing -b <bits>" << endl;
+	  throw exception();
+	}
+    }
   if (all.initial_weight != 0.)
     {
      for (size_t j = 0; j < length << all.reg.stride_shift; j+= ( ((size_t)1) << all.reg.stride_shift))
@@ -55,6 +67,7 @@ void initialize_regressor(vw& all)
 }
 
 const size_t buf_size = 512;
+const char* checkpoint_base_option = "--checkpoint_base=";
 
 void save_load_header(vw& all, io_buf& model_file, bool read, bool text)
 {
@@ -105,6 +118,11 @@ void save_load_header(vw& all, io_buf& model_file, bool read, bool text)
 	  cout << "vw: -b bits mismatch: command-line " << all.num_bits << " != " << local_num_bits << " stored in model" << endl;
 	  throw exception();
 	}
+      if (local_num_bits > max_num_bits)
+	{
+	  cerr << "error: the model has " << local_num_bits << " bits, more than the " << max_num_bits << " feature indices of this build hold: build with 64 bit feature indices to read it" << endl;
+	  throw exception();
+	}
       all.default_bits = false;
       all.num_bits = local_num_bits;
       
@@ -222,20 +240,62 @@ void save_load_header(vw& all, io_buf& model_file, bool read, bool text)
 				"", read, 
 				"\n",1, text);
       
-      text_len = sprintf(buff, "options:%s\n", all.file_options->str().c_str());
-      uint32_t len = (uint32_t)all.file_options->str().length()+1;
-      memcpy(buff2, all.file_options->str().c_str(),len);
+      string options = all.file_options->str();
+      if (!read && !text && all.checkpoint_base != 0)
+	{ // the id the delta checkpoints saved on this model carry
+	  sprintf(buff, " %s%llx", checkpoint_base_option, (unsigned long long)all.checkpoint_base);
+	  options += buff;
+	}
+      text_len = sprintf(buff, "options:%s\n", options.c_str());
+      uint32_t len = (uint32_t)options.length()+1;
+      memcpy(buff2, options.c_str(),len);
       if (read)
 	len = buf_size;
       bin_text_read_write(model_file,buff2, len, 
 			  "", read,
 			  buff, text_len, text);
       if (read)
-	all.file_options->str(buff2);
+	{
+	  options = buff2;
+	  all.checkpoint_base = 0;
+	  size_t base = options.find(string(" ") + checkpoint_base_option);
+	  if (base != string::npos)
+	    { // not an option to parse again
+	      size_t end = options.find(' ', base + 1);
+	      all.checkpoint_base = strtoull(options.c_str() + base + 1 + strlen(checkpoint_base_option), nullptr, 16);
+	      options.erase(base, end == string::npos ? string::npos : end - base);
+	    }
+	  all.file_options->str(options);
+	  // a model is read the way it was written, whatever this run saves
+	  if (options.find("--mmap_model") != string::npos)
+	    all.loaded_layout = WEIGHTS_MAPPABLE;
+	  else if (options.find("--chunked_model") != string::npos)
+	    all.loaded_layout = WEIGHTS_CHUNKED;
+	  else
+	    all.loaded_layout = WEIGHTS_AS_PAIRS;
+	}
     }
 
 }
 
+string delta_checkpoint_name(string reg_name, uint32_t number)
+{
+  stringstream name;
+  name << reg_name << ".delta." << number;
+  return name.str();
+}
+
+static uint64_t checkpoint_key(string reg_name)
+{ return (uint64_t)uniform_hash(reg_name.c_str(), reg_name.length(), 0) + 1; }
+
+// differs from run to run, so that deltas left by another one do not match
+static uint64_t new_checkpoint_base()
+{
+  random_device device;
+  uint64_t id = ((uint64_t)device() << 32) | device();
+  return id != 0 ? id : 1;
+}
+
 void dump_regressor(vw& all, string reg_name, bool as_text)
 {
   if (reg_name == string(""))
@@ -243,6 +303,14 @@ void dump_regressor(vw& all, string reg_name, bool as_text)
   string start_name = reg_name+string(".writing");
   io_buf io_temp;
 
+  // a whole model on the file of the delta checkpoints starts a new chain
+  all.checkpoint_base = 0;
+  if (!as_text && all.sd->checkpoint_name == checkpoint_key(reg_name))
+    {
+      all.sd->checkpoint_base = all.checkpoint_base = new_checkpoint_base();
+      all.sd->checkpoint_deltas = 0;
+    }
+
   io_temp.open_file(start_name.c_str(), all.stdin_off, io_buf::WRITE);
   
   save_load_header(all, io_temp, false, as_text);
@@ -252,6 +320,33 @@ void dump_regressor(vw& all, string reg_name, bool as_text)
   io_temp.close_file();
   remove(reg_name.c_str());
   rename(start_name.c_str(),reg_name.c_str());
+  if (!as_text) // the whole model replaces the delta checkpoints saved on the old one
+    for (uint32_t n = 1; remove(delta_checkpoint_name(reg_name, n).c_str()) == 0; n++)
+      ;
+}
+
+void save_checkpoint(vw& all, string reg_name)
+{
+  uint64_t key = checkpoint_key(reg_name);
+  if (all.sd->checkpoint_name != key)
+    { // the first checkpoint on a file is the whole model
+      memset(all.reg.dirty_rows, 0, all.length());
+      all.sd->checkpoint_name = key;
+      dump_regressor(all, reg_name, false);
+      return;
+    }
+
+  all.delta_number = all.sd->checkpoint_deltas + 1;
+  string delta_name = delta_checkpoint_name(reg_name, all.delta_number);
+  string start_name = delta_name + ".writing";
+  io_buf io_temp;
+  io_temp.open_file(start_name.c_str(), all.stdin_off, io_buf::WRITE);
+  all.l->save_load(io_temp, false, false);
+  io_temp.flush();
+  io_temp.close_file();
+  rename(start_name.c_str(), delta_name.c_str());
+  all.sd->checkpoint_deltas = all.delta_number;
+  all.delta_number = 0;
 }
 
 void save_predictor(vw& all, string reg_name, size_t current_pass)
@@ -292,6 +387,7 @@ void parse_regressor_args(vw& all, po::variables_map& vm, io_buf& io_temp)
 
   if (regs.size() > 0) {
     io_temp.open_file(regs[0].c_str(), all.stdin_off, io_buf::READ);
+    all.model_name = regs[0];
     if (!all.quiet) {
         //cerr << "initial_regressor = " << regs[0] << endl;
       if (regs.size() > 1) {
@@ -320,7 +416,10 @@ void parse_mask_regressor_args(vw& all)
     io_buf io_temp_mask;
     io_temp_mask.open_file(mask_filename.c_str(), false, io_buf::READ);
     save_load_header(all, io_temp_mask, true, false);
+    string model_name = all.model_name;
+    all.model_name = mask_filename;
     all.l->save_load(io_temp_mask, true, false);
+    all.model_name = model_name;
     io_temp_mask.close_file();
 
     // Deal with the over-written header from initial regressor
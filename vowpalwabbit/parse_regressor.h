@@ -18,6 +18,11 @@ void finalize_regressor(vw& all, std::string reg_name);
 void initialize_regressor(vw& all);
 
 void save_predictor(vw& all, std::string reg_name, size_t current_pass);
+// a save example's checkpoint with --delta_checkpoints: the whole model the
+// first time, then only the rows learned since the last one, to
+// reg_name.delta.1, reg_name.delta.2 and so on, which reading reg_name applies
+void save_checkpoint(vw& all, std::string reg_name);
+std::string delta_checkpoint_name(std::string reg_name, uint32_t number);
 void save_load_header(vw& all, io_buf& model_file, bool read, bool text);
 
 void parse_mask_regressor_args(vw& all);
@@ -47,9 +47,13 @@ namespace po = boost::program_options;
 
 #include "parse_example.h"
 #include "cache.h"
+#include "mmap_io.h"
 #include "unique_sort.h"
+#include "interactions.h"
 #include "constant.h"
+#include "placement.h"
 #include "vw.h"
+#include "best_constant.h"
 
 using namespace std;
 
@@ -125,6 +129,51 @@ void condition_variable_signal_all(CV * pcv)
 #endif
 }
 
+// The example ring hands examples between the parse thread and the learner
+// through atomics.  A thread that has to wait spins for a short while and
+// only then registers itself as a waiter and sleeps on the condition
+// variable, so the other side only takes the lock when somebody sleeps.
+const size_t ring_spin_count = 1 << 10;
+
+void wait_until(parser* p, MUTEX* pm, CV* pcv, atomic<size_t>& waiters, bool (*ready)(parser*))
+{
+  for (size_t i = 0; i < ring_spin_count; i++)
+    if (ready(p))
+      return;
+
+  mutex_lock(pm);
+  waiters++;
+  while (!ready(p))
+    condition_variable_wait(pcv, pm);
+  waiters--;
+  mutex_unlock(pm);
+}
+
+void wake_waiters(MUTEX* pm, CV* pcv, atomic<size_t>& waiters)
+{
+  if (waiters == 0)
+    return;
+  mutex_lock(pm);
+  condition_variable_signal_all(pcv);
+  mutex_unlock(pm);
+}
+
+bool unused_example_ready(parser* p)
+{ return !p->slot_in_use[p->begin_parsed_examples % p->ring_size]; }
+
+bool parsed_example_ready(parser* p)
+{ return p->end_parsed_examples != p->used_index || p->done; }
+
+bool outputs_done(parser* p)
+{ return p->local_example_number == p->end_parsed_examples; }
+
+// publishes parsed examples to the learner
+void commit_parsed_examples(parser* p, size_t count)
+{
+  p->end_parsed_examples += count;
+  wake_waiters(&p->examples_lock, &p->example_available, p->available_waiters);
+}
+
 //This should not? matter in a library mode.
 bool got_sigterm;
 
@@ -146,7 +195,11 @@ bool is_test_only(uint32_t counter, uint32_t period, uint32_t after, bool holdou
 parser* new_parser()
 {
   parser& ret = calloc_or_die<parser>();
+#ifdef _WIN32
   ret.input = new io_buf;
+#else
+  ret.input = new mmap_io_buf;
+#endif
   ret.output = new io_buf;
   ret.local_example_number = 0;
   ret.in_pass_counter = 0;
@@ -197,7 +250,13 @@ uint32_t cache_numbits(io_buf* buf, int filepointer)
       cout << "failed to read" << endl;
       throw exception();
     }
-  if (temp != 'c')
+  if (temp == 'c' || temp == 'b') // unblocked, then varint coded caches
+    {
+      cout << "cache has an old format, rebuilding" << endl;
+      t.delete_v();
+      return 0;
+    }
+  if (temp != cache_format)
     {
       cout << "data file is not a cache file" << endl;
       throw exception();
@@ -228,8 +287,10 @@ void reset_source(vw& all, size_t numbits)
 {
   io_buf* input = all.p->input;
   input->current = 0;
+  all.p->cache_block_left = 0;
   if (all.p->write_cache)
     {
+      finish_cache(*all.p);
       all.p->output->flush();
       all.p->write_cache = false;
       all.p->output->close_file();
@@ -241,23 +302,27 @@ void reset_source(vw& all, size_t numbits)
 	else
 	  {
 	    int fd = input->files.pop();
+	    input->stop_read_ahead(fd);
 	    if (!member(all.final_prediction_sink, (size_t) fd))
 	      io_buf::close_file_or_socket(fd);
 	  }
       input->open_file(all.p->output->finalname.begin, all.stdin_off, io_buf::READ); //pushing is merged into open_file
-      all.p->reader = read_cached_features;
+      all.p->reader = read_cached_block_features;
+    }
+  if (all.p->memory_cache != nullptr)
+    {
+      rewind_memory_cache(*all.p);
+      return;
     }
   if ( all.p->resettable == true )
     {
       if (all.daemon)
 	{
 	  // wait for all predictions to be sent back to client
-	  mutex_lock(&all.p->output_lock);
-	  while (all.p->local_example_number != all.p->end_parsed_examples)
-	    condition_variable_wait(&all.p->output_done, &all.p->output_lock);
-	  mutex_unlock(&all.p->output_lock);
+	  wait_until(all.p, &all.p->output_lock, &all.p->output_done, all.p->output_waiters, outputs_done);
 	  
 	  // close socket, erase final prediction sink and socket
+	  all.p->input->stop_read_ahead(all.p->input->files[0]);
 	  io_buf::close_file_or_socket(all.p->input->files[0]);
 	  all.final_prediction_sink.erase();
 	  all.p->input->files.erase();
@@ -275,6 +340,8 @@ void reset_source(vw& all, size_t numbits)
 	  
 	  all.final_prediction_sink.push_back((size_t) f);
 	  all.p->input->files.push_back(f);
+	  if (all.p->read_ahead)
+	    all.p->input->start_read_ahead(f);
 
 	  if (isbinary(*(all.p->input))) {
 	    all.p->reader = read_cached_features;
@@ -309,6 +376,7 @@ void finalize_source(parser* p)
   p->input->close_files();
 
   delete p->input;
+  delete p->memory_cache;
   p->output->close_files();
   delete p->output;
 }
@@ -334,8 +402,12 @@ void make_write_cache(vw& all, string &newname, bool quiet)
 
   output->write_file(f, &v_length, sizeof(v_length));
   output->write_file(f,version.to_string().c_str(),v_length);
-  output->write_file(f,"c",1);
+  output->write_file(f,&cache_format,1);
   output->write_file(f, &all.num_bits, sizeof(all.num_bits));
+  all.p->cache_bytes = sizeof(v_length) + v_length + 1 + sizeof(all.num_bits);
+  all.p->cache_block = new mem_io_buf;
+  all.p->cache_block_count = 0;
+  all.p->cache_index = v_init<cache_index_entry>();
   
   push_many(output->finalname,newname.c_str(),newname.length()+1);
   all.p->write_cache = true;
@@ -373,17 +445,25 @@ void parse_cache(vw& all, po::variables_map &vm, string source,
 	else {
 	  if (!quiet)
 	    cerr << "using cache_file = " << caches[i].c_str() << endl;
-	  all.p->reader = read_cached_features;
+	  all.p->reader = read_cached_block_features;
 	  if (c == all.num_bits)
 	    all.p->sorted_cache = true;
 	  else
 	    all.p->sorted_cache = false;
 	  all.p->resettable = true;
+	  if (i == 0 && all.p->cache_skip > 0)
+	    seek_cache(all, f, all.p->cache_skip);
 	}
       }
     }
+
+  if (all.p->cache_skip > 0 && (caches.size() == 0 || all.p->write_cache))
+    {
+      cerr << "error: --cache_skip needs an existing cache to read" << endl;
+      throw exception();
+    }
   
-  all.parse_mask = (1 << all.num_bits) - 1;
+  all.parse_mask = all.length() - 1;
   if (caches.size() == 0)
     {
       if (!quiet)
@@ -489,16 +569,46 @@ void enable_sources(vw& all, bool quiet, size_t passes)
 #ifdef _WIN32
 		throw exception();
 #else
-	  // weights will be shared across processes, accessible to children
-	  float* shared_weights =
-	    (float*)mmap(0,(all.length() << all.reg.stride_shift) * sizeof(float),
-			 PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
-
-	  size_t float_count = all.length() << all.reg.stride_shift;
-	  weight* dest = shared_weights;
-	  memcpy(dest, all.reg.weight_vector, float_count*sizeof(float));
-	  free(all.reg.weight_vector);
-	  all.reg.weight_vector = dest;
+	  // weights will be shared across processes, accessible to children;
+	  // the compact ones of --quantize are only read, so the children
+	  // share the pages they inherit, and so is the table of
+	  // --sparse_weights when not learning, which can not be shared as it grows,
+	  // and the weights of a model mapped by --mmap_model with -t
+	  if (all.reg.sparse != nullptr && all.training)
+	    {
+	      cerr << "error: --sparse_weights can not learn in --daemon mode, use -t" << endl;
+	      throw exception();
+	    }
+	  if (all.reg.weight_vector != nullptr && (all.training || all.loaded_layout != WEIGHTS_MAPPABLE))
+	    {
+	      size_t float_count = all.length() << all.reg.stride_shift;
+	      size_t mapped_bytes;
+	      weight* dest = allocate_weights(all, float_count, true, mapped_bytes);
+	      memcpy(dest, all.reg.weight_vector, float_count*sizeof(float));
+	      size_t state_count = all.length() * all.reg.state_stride + 1;
+	      size_t state_mapped_bytes = 0;
+	      weight* state = nullptr;
+	      if (all.reg.state_vector != nullptr)
+	        {
+	          state = allocate_weights(all, state_count, true, state_mapped_bytes);
+	          memcpy(state, all.reg.state_vector, state_count*sizeof(float));
+	        }
+	      free_weights(all);
+	      all.reg.weight_vector = dest;
+	      all.weight_bytes_mapped = mapped_bytes;
+	      all.reg.state_vector = state;
+	      all.state_bytes_mapped = state_mapped_bytes;
+	    }
+	  if (all.reg.dirty_rows != nullptr)
+	    { // the rows of --delta_checkpoints any child learns
+	      size_t float_count = ((all.length() + 7) & ~(size_t)7) / sizeof(weight);
+	      size_t mapped_bytes;
+	      weight* dest = allocate_weights(all, float_count, true, mapped_bytes);
+	      memcpy(dest, all.reg.dirty_rows, float_count*sizeof(float));
+	      free_weights((weight*)all.reg.dirty_rows, all.dirty_bytes_mapped);
+	      all.reg.dirty_rows = (unsigned char*)dest;
+	      all.dirty_bytes_mapped = mapped_bytes;
+	    }
 	  
 	  // learning state to be shared across children
 	  shared_data* sd = (shared_data *)mmap(0,sizeof(shared_data),
@@ -580,6 +690,8 @@ void enable_sources(vw& all, bool quiet, size_t passes)
       all.final_prediction_sink.push_back((size_t) f);
       
       all.p->input->files.push_back(f);
+      if (all.p->read_ahead)
+	all.p->input->start_read_ahead(f);
       all.p->max_fd = max(f, all.p->max_fd);
       if (!all.quiet)
 	cerr << "reading data from port " << port << endl;
@@ -615,14 +727,22 @@ void enable_sources(vw& all, bool quiet, size_t passes)
 	    {
 			cerr << "can't open '" << temp << "', sailing on!" << endl;
 	    }
+	  if (all.p->read_ahead)
+	    all.p->input->start_read_ahead(f);
 	  all.p->reader = read_features;
 	  all.p->resettable = all.p->write_cache;
 	}
     }
   
+  if (all.p->cache_in_memory && !all.daemon)
+    {
+      all.p->memory_cache = new mem_io_buf;
+      all.p->resettable = true;
+    }
+
   if (passes > 1 && !all.p->resettable)
     {
-      cerr << all.program_name << ": need a cache file for multiple passes: try using --cache_file" << endl;  
+      cerr << all.program_name << ": need a cache file for multiple passes: try using --cache_file or --cache_in_memory" << endl;  
       throw exception();
     }
   all.p->input->count = all.p->input->files.size();
@@ -644,9 +764,7 @@ bool parser_done(parser* p)
 void set_done(vw& all)
 {
   all.early_terminate = true;
-  mutex_lock(&all.p->examples_lock);
   all.p->done = true;
-  mutex_unlock(&all.p->examples_lock);
 }
 
 void addgrams(vw& all, size_t ngram, size_t skip_gram, v_array<feature>& atomics, v_array<audit_data>& audits,
@@ -660,7 +778,7 @@ void addgrams(vw& all, size_t ngram, size_t skip_gram, v_array<feature>& atomics
 	  size_t new_index = atomics[i].weight_index;
 	  for (size_t n = 1; n < gram_mask.size(); n++)
 	    new_index = new_index*quadratic_constant + atomics[i+gram_mask[n]].weight_index;
-	  feature f = {1.,(uint32_t)(new_index)};
+	  feature f = {1.,(feature_index)(new_index)};
 	  atomics.push_back(f);
 	  if ((all.audit || all.hash_inv) && audits.size() >= initial_length)
 	    {
@@ -702,37 +820,32 @@ void addgrams(vw& all, size_t ngram, size_t skip_gram, v_array<feature>& atomics
  * Hash is evaluated using the principle h(a, b) = h(a)*X + h(b), where X is a random no.
  * 32 random nos. are maintained in an array and are used in the hashing.
  */
-void generateGrams(vw& all, example* &ex) {
+void generateGrams(vw& all, example* &ex, v_array<size_t>& gram_mask) {
   for(unsigned char* index = ex->indices.begin; index < ex->indices.end; index++)
     {
       size_t length = ex->atomics[*index].size();
       for (size_t n = 1; n < all.ngram[*index]; n++)
 	{
-	  all.p->gram_mask.erase();
-	  all.p->gram_mask.push_back((size_t)0);
+	  gram_mask.erase();
+	  gram_mask.push_back((size_t)0);
 	  addgrams(all, n, all.skips[*index], ex->atomics[*index], 
 		   ex->audit_features[*index], 
-		   length, all.p->gram_mask, 0);
+		   length, gram_mask, 0);
 	}
     }
 }
 
 example* get_unused_example(vw& all)
 {
-  while (true)
-    {
-      mutex_lock(&all.p->examples_lock);
-      if (all.p->examples[all.p->begin_parsed_examples % all.p->ring_size].in_use == false)
-	{
-	  example& ret = all.p->examples[all.p->begin_parsed_examples++ % all.p->ring_size];
-	  ret.in_use = true;
-	  mutex_unlock(&all.p->examples_lock);
-	  return &ret;
-	}
-      else 
-	condition_variable_wait(&all.p->example_unused, &all.p->examples_lock);
-      mutex_unlock(&all.p->examples_lock);
-    }
+  parser* p = all.p;
+  wait_until(p, &p->examples_lock, &p->example_unused, p->unused_waiters, unused_example_ready);
+
+  size_t slot = p->begin_parsed_examples % p->ring_size;
+  p->slot_in_use[slot] = true;
+  example& ret = p->examples[slot];
+  ret.in_use = true;
+  p->begin_parsed_examples++;
+  return &ret;
 }
 
 bool parse_atomic_example(vw& all, example* ae, bool do_read = true)
@@ -741,13 +854,12 @@ bool parse_atomic_example(vw& all, example* ae, bool do_read = true)
     return false;
 
   if(all.p->sort_features && ae->sorted == false)
-    unique_sort_features(all.audit, (uint32_t)all.parse_mask, ae);
+    unique_sort_features(all.audit, all.parse_mask, ae);
 
   if (all.p->write_cache) 
-    {
-      all.p->lp.cache_label(&ae->l,*(all.p->output));
-      cache_features(*(all.p->output), ae, (uint32_t)all.parse_mask);
-    }
+    cache_example(all, ae);
+  if (all.p->memory_cache != nullptr && all.p->reader != read_memory_cached_features)
+    memory_cache_example(all, ae);
   return true;
 }
 
@@ -771,15 +883,15 @@ void feature_limit(vw& all, example* ex)
       }
 }
 
-namespace VW{
-void setup_example(vw& all, example* ae)
+//the part of setup_example which depends on the examples parsed before this one
+void setup_example_counters(vw& all, example* ae, uint64_t example_counter)
 {
   ae->partial_prediction = 0.;
   ae->num_features = 0;
   ae->total_sum_feat_sq = 0;
   ae->loss = 0.;
   
-  ae->example_counter = (size_t)(all.p->end_parsed_examples);
+  ae->example_counter = (size_t)example_counter;
   if (!all.p->emptylines_separate_examples)
     all.p->in_pass_counter++;
 
@@ -791,18 +903,25 @@ void setup_example(vw& all, example* ae)
   all.sd->t += all.p->lp.get_weight(&ae->l);
   ae->example_t = (float)all.sd->t;
 
-  
+  // counted here rather than by the label parser, which may run on a parse worker
+  if (all.p->lp.parse_label == simple_label.parse_label)
+    count_label(ae->l.simple.label);
+}
+
+//the part of setup_example which only touches ae, safe to run on any parser thread
+void setup_example_features(vw& all, parser* p, example* ae)
+{
   if (all.ignore_some)
     {
       if (all.audit || all.hash_inv)
 	for (unsigned char* i = ae->indices.begin; i != ae->indices.end; i++)
 	  if (all.ignore[*i])
-	    ae->audit_features[*i].erase();
+	    ae->audit_features[*i].clear();
       
       for (unsigned char* i = ae->indices.begin; i != ae->indices.end; i++)
 	if (all.ignore[*i])
 	  {//delete namespace
-	    ae->atomics[*i].erase();
+	    ae->atomics[*i].clear();
 	    memmove(i,i+1,(ae->indices.end - (i+1))*sizeof(*i));
 	    ae->indices.end--;
 	    i--;
@@ -810,12 +929,12 @@ void setup_example(vw& all, example* ae)
     }
 
   if(all.ngram_strings.size() > 0)
-    generateGrams(all, ae);    
+    generateGrams(all, ae, p->gram_mask);    
 
   if (all.add_constant) {
     //add constant feature
     ae->indices.push_back(constant_namespace);
-    feature temp = {1,(uint32_t) constant};
+    feature temp = {1,(feature_index) constant};
     ae->atomics[constant_namespace].push_back(temp);
     ae->total_sum_feat_sq++;
   }
@@ -827,12 +946,18 @@ void setup_example(vw& all, example* ae)
   if(multiplier != 1) //make room for per-feature information.
     {
       for (unsigned char* i = ae->indices.begin; i != ae->indices.end; i++)
-	for(feature* j = ae->atomics[*i].begin; j != ae->atomics[*i].end; j++)
-	  j->weight_index *= multiplier;
+	{
+	  v_array<feature>& features = ae->atomics[*i];
+	  for(feature* j = features.begin; j != features.end; j++)
+	    j->weight_index *= multiplier;
+	}
       if (all.audit || all.hash_inv)
 	for (unsigned char* i = ae->indices.begin; i != ae->indices.end; i++)
-	  for(audit_data* j = ae->audit_features[*i].begin; j != ae->audit_features[*i].end; j++)
-	    j->weight_index *= multiplier;
+	  {
+	    v_array<audit_data>& audit = ae->audit_features[*i];
+	    for(audit_data* j = audit.begin; j != audit.end; j++)
+	      j->weight_index *= multiplier;
+	  }
     }
   
   for (unsigned char* i = ae->indices.begin; i != ae->indices.end; i++) 
@@ -841,22 +966,14 @@ void setup_example(vw& all, example* ae)
       ae->total_sum_feat_sq += ae->sum_feat_sq[*i];
     }
 
-  for (vector<string>::iterator i = all.pairs.begin(); i != all.pairs.end();i++)
-    {
-      ae->num_features 
-	+= ae->atomics[(int)(*i)[0]].size()
-	*ae->atomics[(int)(*i)[1]].size();
-      ae->total_sum_feat_sq += ae->sum_feat_sq[(int)(*i)[0]]*ae->sum_feat_sq[(int)(*i)[1]];
-    }
-  
-  for (vector<string>::iterator i = all.triples.begin(); i != all.triples.end();i++)
-    {
-      ae->num_features 
-	+= ae->atomics[(int)(*i)[0]].size()
-	*ae->atomics[(int)(*i)[1]].size()
-	*ae->atomics[(int)(*i)[2]].size();
-      ae->total_sum_feat_sq += ae->sum_feat_sq[(int)(*i)[0]] * ae->sum_feat_sq[(int)(*i)[1]] * ae->sum_feat_sq[(int)(*i)[2]];
-    }
+  INTERACTIONS::eval_count_of_interactions(all, *ae, ae->num_features, ae->total_sum_feat_sq);
+}
+
+namespace VW{
+void setup_example(vw& all, example* ae)
+{
+  setup_example_counters(all, ae, all.p->end_parsed_examples);
+  setup_example_features(all, all.p, ae);
 }
 }
 
@@ -885,7 +1002,7 @@ namespace VW{
   void add_constant_feature(vw& vw, example*ec) {
     uint32_t cns = constant_namespace;
     ec->indices.push_back(cns);
-    feature temp = {1,(uint32_t) constant};
+    feature temp = {1,(feature_index) constant};
     ec->atomics[cns].push_back(temp);
     ec->total_sum_feat_sq++;
     ec->num_features++;
@@ -951,7 +1068,8 @@ namespace VW{
 		fs_ptr[fs_count].fs = new feature[fs_ptr[fs_count].len];
 	
 		int f_count = 0;
-		for (feature *f = ec->atomics[*i].begin; f != ec->atomics[*i].end; f++)
+		v_array<feature>& features = ec->atomics[*i];
+		for (feature *f = features.begin; f != features.end; f++)
 		  {
 			feature t = *f;
 			t.weight_index >>= all.reg.stride_shift;
@@ -982,54 +1100,352 @@ namespace VW{
 
   void empty_example(vw& all, example& ec)
   {
-	if (all.audit || all.hash_inv)
-      for (unsigned char* i = ec.indices.begin; i != ec.indices.end; i++) 
-	{
-	  for (audit_data* temp 
-		 = ec.audit_features[*i].begin; 
-	       temp != ec.audit_features[*i].end; temp++)
-	    {
-	      if (temp->alloced)
-		{
-		  free(temp->space);
-		  free(temp->feature);
-		  temp->alloced=false;
-		}
-	    }
-	  ec.audit_features[*i].erase();
-	}
-
-    for (unsigned char* i = ec.indices.begin; i != ec.indices.end; i++) 
-      {
-	ec.atomics[*i].erase();
-	ec.sum_feat_sq[*i]=0;
-      }
-    
-    ec.indices.erase();
-    ec.tag.erase();
+    clear_namespaces(ec);
+    reset_arena(ec.audit_strings);
+    ec.indices.clear();
+    ec.tag.clear();
     ec.sorted = false;
     ec.end_pass = false;
   }
 
   void finish_example(vw& all, example* ec)
   {
-    mutex_lock(&all.p->output_lock);
-    all.p->local_example_number++;
-    condition_variable_signal(&all.p->output_done);
-    mutex_unlock(&all.p->output_lock);
+    parser* p = all.p;
+    p->local_example_number++;
+    wake_waiters(&p->output_lock, &p->output_done, p->output_waiters);
     
     empty_example(all, *ec);
     
-    mutex_lock(&all.p->examples_lock);
     assert(ec->in_use);
     ec->in_use = false;
-    condition_variable_signal(&all.p->example_unused);
-    if (all.p->done)
-      condition_variable_signal_all(&all.p->example_available);
-    mutex_unlock(&all.p->examples_lock);
+    if (ec >= p->examples && ec < p->examples + p->ring_size)
+      {
+	p->slot_in_use[ec - p->examples] = false;
+	wake_waiters(&p->examples_lock, &p->example_unused, p->unused_waiters);
+      }
+    if (p->done)
+      wake_waiters(&p->examples_lock, &p->example_available, p->available_waiters);
   }
 }
 
+// With --parser_threads N the parse thread only reads lines and keeps the
+// bookkeeping that depends on example order; N workers turn the lines into
+// examples.  Work is handed out in batches of lines which are already in the
+// input buffer, so the results are identical to single threaded parsing.
+// Cache files are handed out the same way, a whole cache block at a time.
+enum parse_phase { PARSE_LINES, DECODE_BLOCKS, SETUP_FEATURES, EXIT_WORKERS };
+
+struct parse_worker {
+  vw* all;
+  parser* scratch; //private copy of the parser's tokenizing buffers
+  mem_io_buf* block; //the cache block being decoded
+  size_t id;
+#ifndef _WIN32
+  pthread_t thread;
+#else
+  HANDLE thread;
+#endif
+};
+
+struct cache_block_ref {
+  char* begin;
+  uint64_t bytes;
+  size_t first; // index of its first example in parse_pool::examples
+  size_t count;
+};
+
+struct parse_pool {
+  parse_worker* workers;
+  size_t num_workers;
+
+  v_array<substring> lines;
+  v_array<cache_block_ref> blocks;
+  v_array<example*> examples;
+
+  parse_phase phase;
+  bool warned_serial_cache; // said that cache blocks don't fit the ring
+  uint64_t generation; // bumped every time a phase is handed out
+  size_t pending; // workers still busy with the current phase
+  MUTEX lock;
+  CV start;
+  CV finished;
+};
+
+void decode_cache_blocks(parse_worker& w)
+{
+  vw& all = *w.all;
+  parse_pool& pool = *all.p->pool;
+  size_t count = pool.blocks.size();
+  size_t begin = count * w.id / pool.num_workers;
+  size_t end = count * (w.id + 1) / pool.num_workers;
+
+  for (size_t b = begin; b < end; b++)
+    {
+      cache_block_ref& block = pool.blocks[b];
+      w.block->set_block(block.begin, (size_t)block.bytes);
+      for (size_t i = block.first; i < block.first + block.count; i++)
+	{
+	  example* ae = pool.examples[i];
+	  read_cached_example(all, *w.block, ae);
+	  if (all.p->sort_features && ae->sorted == false)
+	    unique_sort_features(all.audit, all.parse_mask, ae);
+	}
+    }
+}
+
+void parse_worker_run(parse_worker& w, parse_phase phase)
+{
+  if (phase == DECODE_BLOCKS)
+    {
+      decode_cache_blocks(w);
+      return;
+    }
+
+  vw& all = *w.all;
+  parse_pool& pool = *all.p->pool;
+  size_t count = pool.examples.size();
+  size_t begin = count * w.id / pool.num_workers;
+  size_t end = count * (w.id + 1) / pool.num_workers;
+
+  for (size_t i = begin; i < end; i++)
+    {
+      example* ae = pool.examples[i];
+      if (phase == PARSE_LINES)
+	{
+	  read_text_line(&all, w.scratch, ae, pool.lines[i].begin, pool.lines[i].end - pool.lines[i].begin);
+	  if (all.p->sort_features && ae->sorted == false)
+	    unique_sort_features(all.audit, all.parse_mask, ae);
+	}
+      else
+	setup_example_features(all, w.scratch, ae);
+    }
+}
+
+#ifdef _WIN32
+DWORD WINAPI parse_worker_loop(LPVOID in)
+#else
+void *parse_worker_loop(void *in)
+#endif
+{
+  parse_worker& w = *(parse_worker*)in;
+  pin_thread(*w.all);
+  parse_pool& pool = *w.all->p->pool;
+  uint64_t seen = 0;
+
+  while (true)
+    {
+      mutex_lock(&pool.lock);
+      while (pool.generation == seen)
+	condition_variable_wait(&pool.start, &pool.lock);
+      seen = pool.generation;
+      parse_phase phase = pool.phase;
+      mutex_unlock(&pool.lock);
+
+      if (phase == EXIT_WORKERS)
+	return 0L;
+
+      parse_worker_run(w, phase);
+
+      mutex_lock(&pool.lock);
+      if (--pool.pending == 0)
+	condition_variable_signal(&pool.finished);
+      mutex_unlock(&pool.lock);
+    }
+}
+
+void run_parse_phase(parse_pool& pool, parse_phase phase)
+{
+  mutex_lock(&pool.lock);
+  pool.phase = phase;
+  pool.pending = pool.num_workers;
+  pool.generation++;
+  condition_variable_signal_all(&pool.start);
+  while (pool.pending > 0)
+    condition_variable_wait(&pool.finished, &pool.lock);
+  mutex_unlock(&pool.lock);
+}
+
+void start_parse_workers(vw& all)
+{
+  parse_pool& pool = calloc_or_die<parse_pool>();
+  all.p->pool = &pool;
+  pool.num_workers = all.p->parse_threads;
+  pool.workers = calloc_or_die<parse_worker>(pool.num_workers);
+  initialize_mutex(&pool.lock);
+  initialize_condition_variable(&pool.start);
+  initialize_condition_variable(&pool.finished);
+
+  for (size_t i = 0; i < pool.num_workers; i++)
+    {
+      parse_worker& w = pool.workers[i];
+      w.all = &all;
+      w.id = i;
+      w.scratch = &calloc_or_die<parser>();
+      w.scratch->hasher = all.p->hasher;
+      if (all.p->hash_cache_bits > 0)
+	init_hash_cache(w.scratch->names, all.p->hash_cache_bits);
+      w.scratch->lp = all.p->lp;
+      w.block = new mem_io_buf;
+#ifndef _WIN32
+      pthread_create(&w.thread, nullptr, parse_worker_loop, &w);
+#else
+      w.thread = ::CreateThread(nullptr, 0, static_cast<LPTHREAD_START_ROUTINE>(parse_worker_loop), &w, 0L, nullptr);
+#endif
+    }
+}
+
+void end_parse_workers(vw& all)
+{
+  parse_pool& pool = *all.p->pool;
+
+  mutex_lock(&pool.lock);
+  pool.phase = EXIT_WORKERS;
+  pool.generation++;
+  condition_variable_signal_all(&pool.start);
+  mutex_unlock(&pool.lock);
+
+  for (size_t i = 0; i < pool.num_workers; i++)
+    {
+      parse_worker& w = pool.workers[i];
+#ifndef _WIN32
+      pthread_join(w.thread, nullptr);
+#else
+      ::WaitForSingleObject(w.thread, INFINITE);
+      ::CloseHandle(w.thread);
+#endif
+      all.p->names.lookups += w.scratch->names.lookups;
+      all.p->names.hits += w.scratch->names.hits;
+      free_hash_cache(w.scratch->names);
+      w.scratch->words.delete_v();
+      w.scratch->parse_name.delete_v();
+      w.scratch->gram_mask.delete_v();
+      free(w.scratch);
+      delete w.block;
+    }
+  free(pool.workers);
+  pool.lines.delete_v();
+  pool.blocks.delete_v();
+  pool.examples.delete_v();
+  delete_mutex(&pool.lock);
+  free(&pool);
+  all.p->pool = nullptr;
+}
+
+// parse the complete lines sitting in the input buffer (at most half the ring,
+// so the learner can work on one batch while the next one is parsed).  Returns
+// the number of examples made available, 0 if nothing could be read.
+size_t parse_text_batch(vw& all, size_t limit)
+{
+  parser* p = all.p;
+  parse_pool& pool = *p->pool;
+  io_buf* input = p->input;
+
+  size_t batch_size = max(p->ring_size / 2, (size_t)1);
+  if (limit < batch_size)
+    batch_size = limit;
+
+  pool.lines.erase();
+  pool.examples.erase();
+  while (pool.lines.size() < batch_size)
+    {
+      // never block on the source while parsed lines are waiting; this also
+      // guarantees readto doesn't move the lines we already hold
+      if (pool.lines.size() > 0 && memchr(input->space.end, '\n', input->endloaded - input->space.end) == nullptr)
+	break;
+      char* line = nullptr;
+      size_t num_chars = readto(*input, line, '\n');
+      if (num_chars < 1)
+	break;
+      substring l = {line, line + num_chars};
+      pool.lines.push_back(l);
+      pool.examples.push_back(get_unused_example(all));
+    }
+
+  size_t count = pool.examples.size();
+  if (count == 0)
+    return 0;
+
+  run_parse_phase(pool, PARSE_LINES);
+  for (size_t i = 0; i < count; i++)
+    {
+      parse_atomic_example(all, pool.examples[i], false);
+      setup_example_counters(all, pool.examples[i], p->end_parsed_examples + i);
+    }
+  run_parse_phase(pool, SETUP_FEATURES);
+
+  commit_parsed_examples(p, count);
+  return count;
+}
+
+// like parse_text_batch, but for cache files: takes whole cache blocks out of
+// the input (only ones already loaded after the first, so the blocks we hold
+// stay put) and lets the workers decode them.
+size_t parse_cache_batch(vw& all, size_t limit)
+{
+  parser* p = all.p;
+  parse_pool& pool = *p->pool;
+  io_buf* input = p->input;
+
+  if (p->cache_block_left != 0) // a block was started one example at a time
+    return 0;
+
+  size_t batch_size = max(p->ring_size / 2, (size_t)1);
+  if (limit < batch_size)
+    batch_size = limit;
+
+  pool.blocks.erase();
+  pool.examples.erase();
+  while (true)
+    {
+      if (pool.blocks.size() > 0 && (size_t)(input->endloaded - input->space.end) < cache_block_header_size)
+	break;
+      uint64_t bytes;
+      uint32_t examples;
+      char* header = read_cache_block_header(*input, bytes, examples);
+      if (header == nullptr)
+	break;
+      if (examples == 0 || examples > batch_size - pool.examples.size()
+	  || (pool.blocks.size() > 0 && (uint64_t)(input->endloaded - input->space.end) < bytes))
+	{
+	  if (pool.blocks.size() == 0 && examples > max(p->ring_size / 2, (size_t)1) && !pool.warned_serial_cache)
+	    {
+	      if (!all.quiet)
+		cerr << "warning: cache blocks of " << examples << " examples don't fit in half of --ring_size "
+		     << p->ring_size << ", so they are decoded on one thread" << endl;
+	      pool.warned_serial_cache = true;
+	    }
+	  input->set(header); // leave it for the next batch or the example at a time reader
+	  break;
+	}
+      char* begin;
+      if (buf_read(*input, begin, (size_t)bytes) < bytes)
+	{
+	  cerr << "truncated cache block! wanted: " << bytes << " bytes" << endl;
+	  break;
+	}
+      cache_block_ref block = {begin, bytes, pool.examples.size(), examples};
+      pool.blocks.push_back(block);
+      for (uint32_t i = 0; i < examples; i++)
+	pool.examples.push_back(get_unused_example(all));
+    }
+
+  size_t count = pool.examples.size();
+  if (count == 0)
+    return 0;
+
+  run_parse_phase(pool, DECODE_BLOCKS);
+  for (size_t i = 0; i < count; i++)
+    {
+      if (p->memory_cache != nullptr)
+	memory_cache_example(all, pool.examples[i]);
+      setup_example_counters(all, pool.examples[i], p->end_parsed_examples + i);
+    }
+  run_parse_phase(pool, SETUP_FEATURES);
+
+  commit_parsed_examples(p, count);
+  return count;
+}
+
 #ifdef _WIN32
 DWORD WINAPI main_parse_loop(LPVOID in)
 #else
@@ -1038,10 +1454,24 @@ void *main_parse_loop(void *in)
 {
 	vw* all = (vw*) in;
 	size_t example_number = 0;  // for variable-size batch learning algorithms
+	pin_thread(*all);
 
+	if (all->p->parse_threads > 1)
+	  start_parse_workers(*all);
 
 	while(!all->p->done)
 	  {
+	    if (all->p->pool != nullptr && !all->do_reset_source
+		&& (all->p->reader == read_features || all->p->reader == read_cached_block_features)
+		&& example_number != all->pass_length && all->max_examples > example_number)
+	      {
+		size_t limit = min(all->pass_length - example_number, all->max_examples - example_number);
+		size_t parsed = all->p->reader == read_features ? parse_text_batch(*all, limit) : parse_cache_batch(*all, limit);
+		example_number += parsed;
+		if (parsed > 0)
+		  continue;
+	      }
+
             example* ae = get_unused_example(*all);
 	    if (!all->do_reset_source && example_number != all->pass_length && all->max_examples > example_number
 		   && parse_atomic_example(*all, ae) )
@@ -1061,46 +1491,31 @@ void *main_parse_loop(void *in)
 			   all->pass_length = all->pass_length*2+1;
 			 }
 	       if (all->passes_complete >= all->numpasses && all->max_examples >= example_number)
-			 {
-			   mutex_lock(&all->p->examples_lock);
 			   all->p->done = true;
-			   mutex_unlock(&all->p->examples_lock);
-			 }
 	       example_number = 0;
 	     }
-	   mutex_lock(&all->p->examples_lock);
-	   all->p->end_parsed_examples++;
-	   condition_variable_signal_all(&all->p->example_available);
-	   mutex_unlock(&all->p->examples_lock);
+	   commit_parsed_examples(all->p, 1);
 	  }  
+
+	if (all->p->pool != nullptr)
+	  end_parse_workers(*all);
 	return 0L;
 }
 
 namespace VW{
 example* get_example(parser* p)
 {
-  mutex_lock(&p->examples_lock);
+  wait_until(p, &p->examples_lock, &p->example_available, p->available_waiters, parsed_example_ready);
   if (p->end_parsed_examples != p->used_index) {
     size_t ring_index = p->used_index++ % p->ring_size;
     if (!(p->examples+ring_index)->in_use)
       cout << p->used_index << " " << p->end_parsed_examples << " " << ring_index << endl;
     assert((p->examples+ring_index)->in_use);
-    mutex_unlock(&p->examples_lock);
     
     return p->examples + ring_index;
   }
-  else {
-    if (!p->done)
-      {
-	condition_variable_wait(&p->example_available, &p->examples_lock);
-	mutex_unlock(&p->examples_lock);
-	return get_example(p);
-      }
-    else {
-      mutex_unlock(&p->examples_lock);
-      return nullptr;
-    }
-  }
+  else
+    return nullptr;
 }
 
 float get_topic_prediction(example* ec, size_t i)
@@ -1157,6 +1572,7 @@ void initialize_examples(vw& all)
   all.p->done = false;
 
   all.p->examples = calloc_or_die<example>(all.p->ring_size);
+  all.p->slot_in_use = calloc_or_die<atomic<bool> >(all.p->ring_size);
 
   for (size_t i = 0; i < all.p->ring_size; i++)
     {
@@ -1197,6 +1613,7 @@ void free_parser(vw& all)
   all.p->channels.delete_v();
   all.p->words.delete_v();
   all.p->name.delete_v();
+  free_hash_cache(all.p->names);
 
   if(all.ngram_strings.size() > 0)
     all.p->gram_mask.delete_v();
@@ -1208,6 +1625,7 @@ void free_parser(vw& all)
     for (size_t i = 0; i < all.p->ring_size; i++) 
       dealloc_example(all.p->lp.delete_label, all.p->examples[i]);
   free(all.p->examples);
+  free(all.p->slot_in_use);
   
   io_buf* output = all.p->output;
   if (output != nullptr)
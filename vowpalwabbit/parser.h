@@ -4,14 +4,18 @@ individual contributors. All rights reserved.  Released under a BSD
 license as described in the file LICENSE.
  */
 #pragma once
+#include <atomic>
 #include "io_buf.h"
 #include "parse_primitives.h"
 #include "example.h"
+#include "cache.h"
+#include "hash_cache.h"
 
 #include <boost/program_options.hpp>
 namespace po = boost::program_options;
 
 struct vw;
+struct parse_pool;
 
 struct parser {
   v_array<substring> channels;//helper(s) for text parsing
@@ -19,20 +23,35 @@ struct parser {
   v_array<substring> name;
 
   io_buf* input; //Input source(s)
+  bool read_ahead; // read stdin, pipes and sockets on a thread of their own (--read_ahead)
   int (*reader)(void*, example* ae);
   hash_func_t hasher;
+  size_t hash_cache_bits; // log2 of the entries in names, 0 for none (--hash_cache)
+  hash_cache names; // hashes of recent feature names, per parser thread
   bool resettable; //Whether or not the input can be reset.
   io_buf* output; //Where to output the cache.
   bool write_cache; 
+  mem_io_buf* cache_block; // the cache block being written
+  size_t cache_block_count; // examples in cache_block
+  v_array<cache_index_entry> cache_index; // the cache blocks written so far
+  uint64_t cache_bytes; // bytes written to the cache file so far
+  size_t cache_block_left; // examples left in the cache block being read
+  size_t cache_skip; // examples of the cache to seek past on the first pass (--cache_skip)
+  bool cache_in_memory; // replay the first pass from memory (--cache_in_memory)
+  mem_io_buf* memory_cache; // the examples kept for that, when enabled
   bool sort_features;
   bool sorted_cache;
 
+  // The example ring is single producer (the parse thread) / single
+  // consumer (the learner).  The handoff only touches the atomics below;
+  // the locks and condition variables are used to sleep after spinning.
   size_t ring_size;
-  uint64_t begin_parsed_examples; // The index of the beginning parsed example.
-  uint64_t end_parsed_examples; // The index of the fully parsed example.
-  uint64_t local_example_number; 
+  std::atomic<uint64_t> begin_parsed_examples; // The index of the beginning parsed example.
+  std::atomic<uint64_t> end_parsed_examples; // The index of the fully parsed example.
+  std::atomic<uint64_t> local_example_number; 
   uint32_t in_pass_counter;
   example* examples;
+  std::atomic<bool>* slot_in_use; // mirrors examples[i].in_use for the producer
   uint64_t used_index;
   bool emptylines_separate_examples; // true if you want to have holdout computed on a per-block basis rather than a per-line basis
   MUTEX examples_lock;
@@ -40,8 +59,14 @@ struct parser {
   CV example_unused;
   MUTEX output_lock;
   CV output_done;
+  std::atomic<size_t> available_waiters; // threads asleep on example_available
+  std::atomic<size_t> unused_waiters; // threads asleep on example_unused
+  std::atomic<size_t> output_waiters; // threads asleep on output_done
+
+  size_t parse_threads; // number of threads parsing text input (--parser_threads)
+  parse_pool* pool; // the worker threads, when parse_threads > 1
   
-  bool done;
+  std::atomic<bool> done;
   v_array<size_t> gram_mask;
 
   v_array<size_t> ids; //unique ids for sources
@@ -0,0 +1,222 @@
+/*
+Copyright (c) by respective owners including Yahoo!, Microsoft, and
+individual contributors. All rights reserved.  Released under a BSD
+license as described in the file LICENSE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <fstream>
+#endif
+#include "placement.h"
+
+using namespace std;
+
+const size_t huge_page_size = (size_t)1 << 21;
+
+void parse_placement(vw& all, const string& huge_pages, const string& numa)
+{
+  if (huge_pages == "transparent")
+    all.huge_pages = HUGE_PAGES_TRANSPARENT;
+  else if (huge_pages == "explicit")
+    all.huge_pages = HUGE_PAGES_EXPLICIT;
+  else if (huge_pages != "")
+    {
+      cerr << "error: --huge_pages must be transparent or explicit, not " << huge_pages << endl;
+      throw exception();
+    }
+
+  if (numa == "interleave")
+    all.numa_node = numa_interleave;
+  else if (numa != "")
+    {
+      char* end;
+      long node = strtol(numa.c_str(), &end, 10);
+      if (*end != '\0' || node < 0 || node >= 1024)
+	{
+	  cerr << "error: --numa must be interleave or a node number, not " << numa << endl;
+	  throw exception();
+	}
+      all.numa_node = (int)node;
+    }
+
+#ifdef __linux__
+  if (all.pin_threads)
+    { // taken now, before a thread is pinned and its children inherit that
+      cpu_set_t allowed;
+      CPU_ZERO(&allowed);
+      if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	  if (CPU_ISSET(cpu, &allowed))
+	    all.cpus.push_back(cpu);
+    }
+#else
+  if (all.huge_pages != HUGE_PAGES_OFF || all.numa_node != numa_default || all.pin_threads)
+    cerr << "warning: --huge_pages, --numa and --pin_threads only work on linux and are ignored" << endl;
+#endif
+}
+
+#ifdef __linux__
+// the nodes listed in /sys/devices/system/node/online, like "0-3,8"
+static void online_nodes(unsigned long* mask, size_t words)
+{
+  ifstream online("/sys/devices/system/node/online");
+  string ranges;
+  if (!(online >> ranges))
+    ranges = "0";
+  const char* p = ranges.c_str();
+  while (*p != '\0')
+    {
+      char* end;
+      unsigned long first = strtoul(p, &end, 10), last = first;
+      if (*end == '-')
+	last = strtoul(end + 1, &end, 10);
+      for (unsigned long n = first; n <= last && n < words * 64; n++)
+	mask[n / 64] |= 1UL << (n % 64);
+      p = *end == ',' ? end + 1 : end;
+      if (end == p && *p != '\0' && *p != ',')
+	break;
+    }
+}
+
+// mbind without libnuma
+static void place_on_nodes(vw& all, void* begin, size_t bytes)
+{
+  const int mpol_bind = 2, mpol_interleave = 3;
+  const size_t words = 16; // 1024 nodes
+  unsigned long mask[words] = {0};
+  int mode;
+  if (all.numa_node == numa_interleave)
+    {
+      online_nodes(mask, words);
+      mode = mpol_interleave;
+    }
+  else
+    {
+      mask[all.numa_node / 64] = 1UL << (all.numa_node % 64);
+      mode = mpol_bind;
+    }
+  if (syscall(SYS_mbind, begin, bytes, mode, mask, words * 64 + 1, 0) != 0)
+    cerr << "warning: could not place the weights on numa nodes: " << strerror(errno) << endl;
+}
+#endif
+
+weight* allocate_weights(vw& all, size_t count, bool shared, size_t& mapped_bytes)
+{
+  size_t bytes = count * sizeof(weight);
+  mapped_bytes = 0;
+#ifndef _WIN32
+  bool placed = all.huge_pages != HUGE_PAGES_OFF || all.numa_node != numa_default;
+  if (!shared && !placed)
+    return calloc_or_die<weight>(count);
+
+  int flags = (shared ? MAP_SHARED : MAP_PRIVATE) | MAP_ANONYMOUS;
+  void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (all.huge_pages == HUGE_PAGES_EXPLICIT)
+    {
+      mapped_bytes = (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+      p = mmap(0, mapped_bytes, PROT_READ|PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+      if (p == MAP_FAILED)
+	cerr << "warning: no explicit huge pages for the weights (see /proc/sys/vm/nr_hugepages), trying transparent ones" << endl;
+    }
+#endif
+  if (p == MAP_FAILED)
+    {
+      // map a huge page more than needed and trim it, so the weights
+      // start on a huge page boundary
+      size_t extra = placed ? huge_page_size : 0;
+      char* raw = (char*)mmap(0, bytes + extra, PROT_READ|PROT_WRITE, flags, -1, 0);
+      if (raw == (char*)MAP_FAILED)
+	{
+	  cerr << all.program_name << ": Failed to map weight array with " << all.num_bits << " bits: try decreasing -b <bits>" << endl;
+	  throw exception();
+	}
+      char* begin = raw;
+      if (extra > 0)
+	{
+	  begin = (char*)(((size_t)raw + huge_page_size - 1) & ~(huge_page_size - 1));
+	  if (begin > raw)
+	    munmap(raw, begin - raw);
+	  munmap(begin + bytes, raw + extra - begin);
+	}
+      p = begin;
+      mapped_bytes = bytes;
+#ifdef MADV_HUGEPAGE
+      if (all.huge_pages != HUGE_PAGES_OFF && madvise(p, bytes, MADV_HUGEPAGE) != 0)
+	cerr << "warning: transparent huge pages are not available for the weights" << endl;
+#endif
+    }
+#ifdef __linux__
+  if (all.numa_node != numa_default)
+    place_on_nodes(all, p, bytes);
+#endif
+  return (weight*)p;
+#else
+  return calloc_or_die<weight>(count);
+#endif
+}
+
+weight* map_weights(int f, size_t offset, size_t count, bool writable, size_t& mapped_bytes)
+{
+  mapped_bytes = 0;
+#ifndef _WIN32
+  size_t bytes = count * sizeof(weight);
+  long page = sysconf(_SC_PAGESIZE);
+  struct stat st; // a short file would fault when the missing pages are read
+  if (bytes == 0 || page <= 0 || offset % page != 0
+      || fstat(f, &st) != 0 || !S_ISREG(st.st_mode) || (size_t)st.st_size < offset + bytes)
+    return nullptr;
+  void* p = mmap(0, bytes, writable ? PROT_READ|PROT_WRITE : PROT_READ, MAP_PRIVATE, f, offset);
+  if (p == MAP_FAILED)
+    return nullptr;
+  mapped_bytes = bytes;
+  return (weight*)p;
+#else
+  return nullptr;
+#endif
+}
+
+void free_weights(weight* w, size_t mapped_bytes)
+{
+#ifndef _WIN32
+  if (mapped_bytes > 0)
+    munmap(w, mapped_bytes);
+  else
+#endif
+    free(w);
+}
+
+void free_weights(vw& all)
+{
+  if (all.reg.state_vector != nullptr)
+    free_weights(all.reg.state_vector, all.state_bytes_mapped);
+  all.reg.state_vector = nullptr;
+  all.state_bytes_mapped = 0;
+  if (all.reg.weight_vector == nullptr)
+    return;
+  free_weights(all.reg.weight_vector, all.weight_bytes_mapped);
+  all.reg.weight_vector = nullptr;
+  all.weight_bytes_mapped = 0;
+}
+
+void pin_thread(vw& all)
+{
+#ifdef __linux__
+  if (all.cpus.size() == 0)
+    return;
+  cpu_set_t one;
+  CPU_ZERO(&one);
+  CPU_SET(all.cpus[all.next_cpu++ % all.cpus.size()], &one);
+  pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+#endif
+}
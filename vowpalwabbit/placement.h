@@ -0,0 +1,36 @@
+/*
+Copyright (c) by respective owners including Yahoo!, Microsoft, and
+individual contributors. All rights reserved.  Released under a BSD
+license as described in the file LICENSE.
+ */
+#pragma once
+#include "global_data.h"
+
+// Where the weight vector and the threads working on it live.  With
+// --huge_pages or --numa the weights are mmaped instead of calloced, so
+// they can be backed by 2MB pages (cutting the TLB misses of the random
+// accesses in foreach_feature) and spread over or bound to NUMA nodes
+// before they are first touched.  --pin_threads gives the parse, learner
+// and minibatch threads cpus of their own.
+
+enum huge_page_mode { HUGE_PAGES_OFF, HUGE_PAGES_TRANSPARENT, HUGE_PAGES_EXPLICIT };
+
+const int numa_default = -2; // leave the weights to the kernel's policy
+const int numa_interleave = -1; // spread them page by page over all nodes
+
+void parse_placement(vw& all, const std::string& huge_pages, const std::string& numa);
+
+// count zeroed weights; shared ones are seen by forked children.  Sets
+// mapped_bytes to the length of the mapping, 0 if they were calloced.
+weight* allocate_weights(vw& all, size_t count, bool shared, size_t& mapped_bytes);
+// frees all.reg.weight_vector and all.reg.state_vector
+void free_weights(vw& all);
+// frees what allocate_weights returned
+void free_weights(weight* w, size_t mapped_bytes);
+// count weights of file f starting at offset, a multiple of the page size,
+// mapped privately: writes stay in the process and reads share the page
+// cache.  Read-only unless writable.  nullptr when the file can't be mapped.
+weight* map_weights(int f, size_t offset, size_t count, bool writable, size_t& mapped_bytes);
+
+// pins the calling thread to the next cpu the process may use
+void pin_thread(vw& all);
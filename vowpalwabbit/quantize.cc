@@ -0,0 +1,164 @@
+/*
+Copyright (c) by respective owners including Yahoo!, Microsoft, and
+individual contributors. All rights reserved.  Released under a BSD
+license as described in the file LICENSE.
+ */
+#include <math.h>
+#include <float.h>
+#include "quantize.h"
+#include "placement.h"
+
+using namespace std;
+
+const size_t no_block = (size_t)-1;
+
+int parse_quantize(const string& mode)
+{
+  if (mode == "fp16")
+    return QUANTIZE_FP16;
+  if (mode == "bf16")
+    return QUANTIZE_BF16;
+  if (mode == "int8")
+    return QUANTIZE_INT8;
+  cerr << "error: --quantize must be fp16, bf16 or int8, not " << mode << endl;
+  throw exception();
+}
+
+const char* quantize_name(int mode)
+{
+  switch (mode)
+    {
+    case QUANTIZE_FP16: return "fp16";
+    case QUANTIZE_BF16: return "bf16";
+    case QUANTIZE_INT8: return "int8";
+    default: return "off";
+    }
+}
+
+void init_quantized(vw& all, int mode, bool report)
+{
+  quantized_weights& q = calloc_or_die<quantized_weights>();
+  size_t length = all.reg.weight_mask + 1;
+  q.mode = mode;
+  q.report = report;
+  q.pending_block = no_block;
+  size_t blocks = (length + quantize_block_size - 1) >> quantize_block_shift;
+  if (mode == QUANTIZE_INT8)
+    q.size = blocks * (sizeof(float) + quantize_block_size);
+  else
+    q.size = length * sizeof(uint16_t);
+
+  q.memory = allocate_weights(all, (q.size + sizeof(weight) - 1) / sizeof(weight), false, q.mapped_bytes);
+  if (q.memory == nullptr)
+    {
+      cerr << all.program_name << ": Failed to allocate the " << quantize_name(mode) << " weights with " << all.num_bits << " bits: try decreasing -b <bits>" << endl;
+      throw exception();
+    }
+  if (mode == QUANTIZE_INT8)
+    { // the scales first, so they stay aligned
+      q.scales = (float*)q.memory;
+      q.bytes = (int8_t*)(q.scales + blocks);
+    }
+  else
+    q.halves = (uint16_t*)q.memory;
+  if (mode == QUANTIZE_FP16)
+    {
+      q.widened = calloc_or_die<float>(1 << 16);
+      for (size_t h = 0; h < (1 << 16); h++)
+	q.widened[h] = half_to_float((uint16_t)h);
+    }
+  all.reg.quantized = &q;
+}
+
+static void store_pending(quantized_weights& q)
+{
+  if (q.pending_block == no_block)
+    return;
+  float max_abs = 0.f;
+  for (size_t j = 0; j < quantize_block_size; j++)
+    max_abs = max(max_abs, fabsf(q.pending[j]));
+  float scale = max_abs / 127.f;
+  int8_t* bytes = q.bytes + (q.pending_block << quantize_block_shift);
+  for (size_t j = 0; j < quantize_block_size; j++)
+    bytes[j] = scale > 0.f ? (int8_t)lrintf(q.pending[j] / scale) : 0;
+  q.scales[q.pending_block] = scale;
+  q.pending_block = no_block;
+}
+
+void set_quantized(quantized_weights& q, size_t i, float w)
+{
+  switch (q.mode)
+    {
+    case QUANTIZE_FP16:
+      q.halves[i] = float_to_half(w);
+      break;
+    case QUANTIZE_BF16:
+      q.halves[i] = float_to_bf16(w);
+      break;
+    case QUANTIZE_INT8:
+      { // a model file lists its weights in order, so a block is usually
+	// complete when the next one starts
+	size_t block = i >> quantize_block_shift;
+	if (block != q.pending_block)
+	  {
+	    store_pending(q);
+	    int8_weights stored(q);
+	    for (size_t j = 0; j < quantize_block_size; j++)
+	      q.pending[j] = stored[(block << quantize_block_shift) + j];
+	    q.pending_block = block;
+	  }
+	q.pending[i & (quantize_block_size - 1)] = w;
+      }
+    }
+}
+
+void finish_loading_quantized(quantized_weights& q)
+{
+  if (q.mode == QUANTIZE_INT8)
+    store_pending(q);
+}
+
+void report_quantized(vw& all, example& ec, float prediction, float quantized_prediction)
+{
+  quantized_weights& q = *all.reg.quantized;
+  double delta = fabs((double)prediction - quantized_prediction);
+  q.predictions++;
+  q.sum_delta += delta;
+  q.max_delta = max(q.max_delta, delta);
+  label_data& ld = ec.l.simple;
+  if (ld.label != FLT_MAX)
+    {
+      q.labeled_weight += ld.weight;
+      q.loss += all.loss->getLoss(all.sd, prediction, ld.label) * ld.weight;
+      q.quantized_loss += all.loss->getLoss(all.sd, quantized_prediction, ld.label) * ld.weight;
+    }
+}
+
+void finish_quantized(vw& all)
+{
+  quantized_weights* q = all.reg.quantized;
+  if (q == nullptr)
+    return;
+  if (q->report)
+    {
+      size_t length = all.reg.weight_mask + 1;
+      cerr.precision(6);
+      cerr << endl << "quantized weights = " << quantize_name(q->mode) << ", " << q->size << " bytes for " << length << " weights (fp32: " << length * sizeof(float) << ")";
+      cerr << endl << "predictions compared = " << q->predictions;
+      if (q->predictions > 0)
+	cerr << endl << "mean prediction delta = " << q->sum_delta / q->predictions
+	     << endl << "max prediction delta = " << q->max_delta;
+      if (q->labeled_weight > 0)
+	{
+	  double loss = q->loss / q->labeled_weight;
+	  double quantized_loss = q->quantized_loss / q->labeled_weight;
+	  cerr << endl << "average loss fp32 = " << loss
+	       << endl << "average loss " << quantize_name(q->mode) << " = " << quantized_loss << " (" << (quantized_loss >= loss ? "+" : "") << quantized_loss - loss << ")";
+	}
+      cerr << endl;
+    }
+  free_weights(q->memory, q->mapped_bytes);
+  free(q->widened);
+  free(q);
+  all.reg.quantized = nullptr;
+}
@@ -0,0 +1,143 @@
+/*
+Copyright (c) by respective owners including Yahoo!, Microsoft, and
+individual contributors. All rights reserved.  Released under a BSD
+license as described in the file LICENSE.
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include "global_data.h"
+
+// --quantize fp16|bf16|int8 keeps the weights of a model loaded with -t in a
+// compact array instead of 2^b floats: 2 bytes a weight for fp16 and bf16,
+// and for int8 1 byte plus a float scale per block of 64 weights (the
+// block's largest magnitude over 127).  Weights are rounded as they are read
+// from the model file, so the floats are never allocated, and widened again
+// as gd's predict reads them.  --quantize_report keeps the floats as well,
+// predicts with both and prints how far the predictions and the loss moved.
+
+enum quantize_mode { QUANTIZE_OFF, QUANTIZE_FP16, QUANTIZE_BF16, QUANTIZE_INT8 };
+
+const size_t quantize_block_shift = 6;
+const size_t quantize_block_size = (size_t)1 << quantize_block_shift;
+
+struct quantized_weights {
+  int mode; // a quantize_mode
+  weight* memory; // one allocation holding the arrays below
+  size_t mapped_bytes;
+  size_t size; // bytes used by the arrays
+  uint16_t* halves; // fp16 or bf16
+  int8_t* bytes; // int8
+  float* scales; // int8, one per block
+  float* widened; // fp16: every half as a float, as a lookup is cheaper than widening
+
+  // int8: the block being filled from the model file, widened
+  size_t pending_block;
+  float pending[quantize_block_size];
+
+  // --quantize_report
+  bool report;
+  size_t predictions;
+  double sum_delta;
+  double max_delta;
+  double labeled_weight;
+  double loss;
+  double quantized_loss;
+};
+
+int parse_quantize(const std::string& mode);
+const char* quantize_name(int mode);
+
+// allocates the compact weights for all.reg.weight_mask+1 zero weights
+void init_quantized(vw& all, int mode, bool report);
+// stores weight i, as read from a model file
+void set_quantized(quantized_weights& q, size_t i, float w);
+// stores what set_quantized has not yet, once the model is read
+void finish_loading_quantized(quantized_weights& q);
+// prints the report if asked for and frees all.reg.quantized
+void finish_quantized(vw& all);
+// adds one prediction from the floats and one from the compact weights
+void report_quantized(vw& all, example& ec, float prediction, float quantized_prediction);
+
+inline uint16_t float_to_half(float f)
+{ // round to nearest even; magnitudes beyond fp16's range become its largest
+  uint32_t u;
+  memcpy(&u, &f, sizeof(u));
+  uint32_t sign = u & 0x80000000u;
+  u ^= sign;
+  uint16_t h;
+  if (u >= (uint32_t)(127 + 16) << 23)
+    h = u > (uint32_t)255 << 23 ? 0x7e00 : (u == (uint32_t)255 << 23 ? 0x7c00 : 0x7bff);
+  else if (u < (uint32_t)113 << 23)
+    { // subnormal or zero: adding 0.5 lines the mantissa up with the fp16 one
+      uint32_t magic_u = (uint32_t)((127 - 15) + (23 - 10) + 1) << 23;
+      float magic, g;
+      memcpy(&magic, &magic_u, sizeof(magic));
+      memcpy(&g, &u, sizeof(g));
+      g += magic;
+      memcpy(&u, &g, sizeof(u));
+      h = (uint16_t)(u - magic_u);
+    }
+  else
+    {
+      uint32_t odd = (u >> 13) & 1;
+      u += ((uint32_t)(15 - 127) << 23) + 0xfff + odd;
+      h = (uint16_t)std::min(u >> 13, (uint32_t)0x7bff);
+    }
+  return h | (uint16_t)(sign >> 16);
+}
+
+inline float half_to_float(uint16_t h)
+{
+  uint32_t exponent = (uint32_t)h & 0x7c00u;
+  float f;
+  if (exponent == 0) // zero or subnormal
+    f = (float)(h & 0x3ffu) * (1.f / (1 << 24));
+  else
+    {
+      uint32_t u = (((uint32_t)h & 0x7fffu) << 13) + ((uint32_t)(127 - 15) << 23);
+      if (exponent == 0x7c00u) // inf or nan
+	u += (uint32_t)(128 - 16) << 23;
+      memcpy(&f, &u, sizeof(f));
+    }
+  return (h & 0x8000u) ? -f : f;
+}
+
+inline uint16_t float_to_bf16(float f)
+{ // the top half of the float, rounded to nearest even
+  uint32_t u;
+  memcpy(&u, &f, sizeof(u));
+  if ((u & 0x7fffffffu) > 0x7f800000u) // nan stays nan
+    return (uint16_t)((u >> 16) | 0x40);
+  return (uint16_t)((u + 0x7fff + ((u >> 16) & 1)) >> 16);
+}
+
+inline float bf16_to_float(uint16_t h)
+{
+  uint32_t u = (uint32_t)h << 16;
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+// Readers of the compact weights for gd's predict: w[i] is weight i.
+struct fp16_weights {
+  const uint16_t* halves;
+  const float* widened;
+  fp16_weights(quantized_weights& q) : halves(q.halves), widened(q.widened) {}
+  inline float operator[](size_t i) const { return widened[halves[i]]; }
+};
+
+struct bf16_weights {
+  const uint16_t* halves;
+  bf16_weights(quantized_weights& q) : halves(q.halves) {}
+  inline float operator[](size_t i) const { return bf16_to_float(halves[i]); }
+};
+
+struct int8_weights {
+  const int8_t* bytes;
+  const float* scales;
+  int8_weights(quantized_weights& q) : bytes(q.bytes), scales(q.scales) {}
+  inline float operator[](size_t i) const { return bytes[i] * scales[i >> quantize_block_shift]; }
+};
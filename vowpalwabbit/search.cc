@@ -419,12 +419,12 @@ namespace Search {
     all.sd->update_dump_interval(all.progress_add, all.progress_arg);
   }
 
-  void add_new_feature(search_private& priv, float val, uint32_t idx) {
+  void add_new_feature(search_private& priv, float val, feature_index idx) {
     size_t mask = priv.all->reg.weight_mask;
     size_t ss   = priv.all->reg.stride_shift;
     size_t idx2 = ((idx & mask) >> ss) & mask;
     feature f = { val * priv.dat_new_feature_value,
-                  (uint32_t) (((priv.dat_new_feature_idx + idx2) << ss) ) };
+                  (feature_index) (((priv.dat_new_feature_idx + idx2) << ss) ) };
     priv.dat_new_feature_ec->atomics[priv.dat_new_feature_namespace].push_back(f);
     priv.dat_new_feature_ec->sum_feat_sq[priv.dat_new_feature_namespace] += f.x * f.x;
     if (priv.all->audit) {
@@ -609,7 +609,7 @@ namespace Search {
 
         // add the quadratic features
         if (n < priv.acset.max_quad_ngram_length)
-          GD::foreach_feature<search_private,uint32_t,add_new_feature>(*priv.all, ec, priv);
+          GD::foreach_feature<search_private,feature_index,add_new_feature>(*priv.all, ec, priv);
       }
     }
 
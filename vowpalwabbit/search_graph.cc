@@ -187,21 +187,21 @@ namespace GraphTask {
     D.adj.clear();
   }
 
-  void add_edge_features_group_fn(task_data&D, float fv, uint32_t fx) {
+  void add_edge_features_group_fn(task_data&D, float fv, feature_index fx) {
     example*node = D.cur_node;
     for (size_t k=0; k<=D.K; k++) {
       if (D.neighbor_predictions[k] == 0.) continue;
-      feature f = { fv * D.neighbor_predictions[k], (uint32_t) ((( ((fx & D.mask) >> D.ss) + 348919043 * k ) << D.ss) & D.mask) };
+      feature f = { fv * D.neighbor_predictions[k], (feature_index) ((( ((fx & D.mask) >> D.ss) + 348919043 * k ) << D.ss) & D.mask) };
       node->atomics[neighbor_namespace].push_back(f);
       node->sum_feat_sq[neighbor_namespace] += f.x * f.x;
     }
     // TODO: audit
   }
 
-  void add_edge_features_single_fn(task_data&D, float fv, uint32_t fx) {
+  void add_edge_features_single_fn(task_data&D, float fv, feature_index fx) {
     example*node = D.cur_node;
     size_t k = (size_t) D.neighbor_predictions[0];
-    feature f = { fv, (uint32_t) (( ((fx & D.mask) >> D.ss) + 348919043 * k ) << D.ss) };
+    feature f = { fv, (feature_index) (( ((fx & D.mask) >> D.ss) + 348919043 * k ) << D.ss) };
     node->atomics[neighbor_namespace].push_back(f);
     node->sum_feat_sq[neighbor_namespace] += f.x * f.x;
     // TODO: audit
@@ -234,9 +234,9 @@ namespace GraphTask {
       example&edge = *ec[i];
       if (pred_total <= 1.) {  // single edge
         D.neighbor_predictions[0] = (float)last_pred;
-        GD::foreach_feature<task_data,uint32_t,add_edge_features_single_fn>(sch.get_vw_pointer_unsafe(), edge, D);
+        GD::foreach_feature<task_data,feature_index,add_edge_features_single_fn>(sch.get_vw_pointer_unsafe(), edge, D);
       } else // lots of edges
-        GD::foreach_feature<task_data,uint32_t,add_edge_features_group_fn>(sch.get_vw_pointer_unsafe(), edge, D);
+        GD::foreach_feature<task_data,feature_index,add_edge_features_group_fn>(sch.get_vw_pointer_unsafe(), edge, D);
     }
     ec[n]->indices.push_back(neighbor_namespace);
     ec[n]->total_sum_feat_sq += ec[n]->sum_feat_sq[neighbor_namespace];
@@ -36,7 +36,7 @@ void open_sockets(sender& s, string host)
   s.buf->files.push_back(s.sd);
 }
 
-void send_features(io_buf *b, example& ec, uint32_t mask)
+void send_features(io_buf *b, example& ec, size_t mask)
 { // note: subtracting 1 b/c not sending constant
   output_byte(*b,(unsigned char) (ec.indices.size()-1));
   
@@ -70,7 +70,7 @@ void learn(sender& s, LEARNER::base_learner& base, example& ec)
   s.all->set_minmax(s.all->sd, ec.l.simple.label);
   s.all->p->lp.cache_label(&ec.l, *s.buf);//send label information.
   cache_tag(*s.buf, ec.tag);
-  send_features(s.buf,ec, (uint32_t)s.all->parse_mask);
+  send_features(s.buf,ec, s.all->parse_mask);
   s.delay_ring[s.sent_index++ % s.all->p->ring_size] = &ec;
 }
 
@@ -17,8 +17,6 @@ char* bufread_simple_label(shared_data* sd, label_data* ld, char* c)
   c += sizeof(ld->weight);
   memcpy(&ld->initial, c, sizeof(ld->initial));
   c += sizeof(ld->initial);
-
-  count_label(ld->label);
   return c;
 }
 
@@ -94,7 +92,6 @@ void parse_simple_label(parser* p, shared_data* sd, void* v, v_array<substring>&
     cerr << "malformed example!\n";
     cerr << "words.size() = " << words.size() << endl;
   }
-  count_label(ld->label);
 }
 
 label_parser simple_label = {default_simple_label, parse_simple_label,
@@ -0,0 +1,92 @@
+/*
+Copyright (c) by respective owners including Yahoo!, Microsoft, and
+individual contributors. All rights reserved.  Released under a BSD
+license as described in the file LICENSE.
+ */
+#include <string.h>
+#include <algorithm>
+#include "sparse_weights.h"
+
+using namespace std;
+
+const uint32_t initial_bits = 10;
+
+static void allocate_table(sparse_weights& s, uint32_t bits)
+{
+  s.table = calloc_or_die<uint64_t>(((size_t)1 << bits) * s.entry_words);
+  s.mask = ((size_t)1 << bits) - 1;
+  s.hash_shift = 64 - bits;
+  s.count = 0;
+}
+
+void init_sparse_weights(vw& all)
+{
+  if (all.reg.sparse != nullptr)
+    return;
+  all.reg.weight_mask = (all.length() << all.reg.stride_shift) - 1;
+  sparse_weights& s = calloc_or_die<sparse_weights>();
+  s.stride_shift = all.reg.stride_shift;
+  s.stride = (size_t)1 << s.stride_shift;
+  // the key and the row, rounded up to whole words so the keys stay aligned
+  s.entry_words = 1 + (s.stride * sizeof(weight) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+  s.initial = calloc_or_die<weight>(s.stride);
+  s.initial[0] = all.initial_weight;
+  allocate_table(s, initial_bits);
+  all.reg.sparse = &s;
+}
+
+static uint64_t* empty_entry(sparse_weights& s, uint64_t key)
+{
+  for (size_t i = sparse_slot(s, key);; i = (i + 1) & s.mask)
+    {
+      uint64_t* e = s.table + i * s.entry_words;
+      if (*e == 0)
+	return e;
+    }
+}
+
+weight* insert_row(sparse_weights& s, uint64_t row)
+{
+  if ((s.count + 1) * 10 > (s.mask + 1) * 7)
+    { // double the table and move the entries over
+      uint64_t* old = s.table;
+      size_t old_entries = s.mask + 1;
+      allocate_table(s, 64 - s.hash_shift + 1);
+      for (size_t i = 0; i < old_entries; i++)
+	{
+	  uint64_t* e = old + i * s.entry_words;
+	  if (*e != 0)
+	    {
+	      memcpy(empty_entry(s, *e), e, s.entry_words * sizeof(uint64_t));
+	      s.count++;
+	    }
+	}
+      free(old);
+    }
+  uint64_t* e = empty_entry(s, row + 1);
+  *e = row + 1;
+  weight* r = (weight*)(e + 1);
+  memcpy(r, s.initial, s.stride * sizeof(weight));
+  s.count++;
+  return r;
+}
+
+void sorted_rows(sparse_weights& s, v_array<uint64_t>& rows)
+{
+  rows.erase();
+  for (size_t i = 0; i < sparse_entries(s); i++)
+    if (entry_row(s, i) != nullptr)
+      rows.push_back(s.table[i * s.entry_words] - 1);
+  sort(rows.begin, rows.end);
+}
+
+void free_sparse_weights(vw& all)
+{
+  sparse_weights* s = all.reg.sparse;
+  if (s == nullptr)
+    return;
+  free(s->table);
+  free(s->initial);
+  free(s);
+  all.reg.sparse = nullptr;
+}
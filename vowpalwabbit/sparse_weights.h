@@ -0,0 +1,82 @@
+/*
+Copyright (c) by respective owners including Yahoo!, Microsoft, and
+individual contributors. All rights reserved.  Released under a BSD
+license as described in the file LICENSE.
+ */
+#pragma once
+#include <stdint.h>
+#include "global_data.h"
+
+// --sparse_weights keeps gd's weights in an open addressing table instead
+// of a 2^b << stride_shift array, so memory follows the number of features
+// that were learned rather than b.  A row (the stride of floats of one
+// weight) gets an entry the first time it is written to; reading a row not
+// in the table reads the initial row, which is what the entry would start
+// as.  Saving walks only the entries.  The table doubles past 70% load,
+// which moves the rows, so a row's address is only good until the next
+// insertion.
+struct sparse_weights {
+  uint64_t* table; // entries of entry_words words: the row number + 1 (0 when empty), then the row's floats
+  size_t mask; // entries - 1
+  uint32_t hash_shift; // 64 - log2(entries)
+  size_t count;
+  size_t stride; // floats per row
+  uint32_t stride_shift;
+  size_t entry_words;
+  weight* initial;
+};
+
+inline size_t sparse_slot(const sparse_weights& s, uint64_t key)
+{ return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> s.hash_shift); }
+
+// the floats of row, or nullptr when it has no entry
+inline weight* find_row(sparse_weights& s, uint64_t row)
+{
+  uint64_t key = row + 1;
+  for (size_t i = sparse_slot(s, key);; i = (i + 1) & s.mask)
+    {
+      uint64_t* e = s.table + i * s.entry_words;
+      if (*e == key)
+	return (weight*)(e + 1);
+      if (*e == 0)
+	return nullptr;
+    }
+}
+
+weight* insert_row(sparse_weights& s, uint64_t row);
+
+inline weight* get_row(sparse_weights& s, uint64_t row)
+{
+  weight* r = find_row(s, row);
+  return r != nullptr ? r : insert_row(s, row);
+}
+
+// the weight at index, as weight_vector[index] would be; with insert false
+// a row not in the table is read from the initial row, which must not be
+// written to
+inline weight& sparse_weight(sparse_weights& s, size_t index, bool insert)
+{
+  uint64_t row = index >> s.stride_shift;
+  weight* r = find_row(s, row);
+  if (r == nullptr)
+    r = insert ? insert_row(s, row) : s.initial;
+  return r[index & (s.stride - 1)];
+}
+
+// walking the table: entry e holds a row when entry_row is not nullptr
+inline size_t sparse_entries(const sparse_weights& s) { return s.mask + 1; }
+inline weight* entry_row(sparse_weights& s, size_t e)
+{
+  uint64_t* p = s.table + e * s.entry_words;
+  return *p != 0 ? (weight*)(p + 1) : nullptr;
+}
+
+// the weight at index of either layout, for code that only reads it
+inline weight read_weight(regressor& reg, size_t index)
+{ return reg.sparse != nullptr ? sparse_weight(*reg.sparse, index, false) : reg.weight_vector[index]; }
+
+// sets all.reg.sparse up for a stride of 1 << all.reg.stride_shift
+void init_sparse_weights(vw& all);
+void free_sparse_weights(vw& all);
+// the rows with an entry, in increasing order
+void sorted_rows(sparse_weights& s, v_array<uint64_t>& rows);
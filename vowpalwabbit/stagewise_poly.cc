@@ -409,8 +409,8 @@ using namespace LEARNER;
 
   void synthetic_decycle(stagewise_poly &poly)
   {
-    for (feature *f = poly.synth_ec.atomics[tree_atomics].begin;
-        f != poly.synth_ec.atomics[tree_atomics].end; ++f) {
+    v_array<feature>& features = poly.synth_ec.atomics[tree_atomics];
+    for (feature *f = features.begin; f != features.end; ++f) {
       assert(cycle_get(poly, f->weight_index));
       cycle_toggle(poly, f->weight_index);
     }
@@ -640,7 +640,7 @@ using namespace LEARNER;
     cout << "total feature number (after poly expansion!) = " << poly.sum_sparsity << endl;
 #endif //DEBUG
 
-    poly.synth_ec.atomics[tree_atomics].delete_v();
+    free_namespaces(poly.synth_ec);
     sort_data_destroy(poly);
     depthsbits_destroy(poly);
   }
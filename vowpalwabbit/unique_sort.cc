@@ -6,11 +6,15 @@ license as described in the file LICENSE.
 #include "example.h"
 
 int order_features(const void* first, const void* second)
-{ return ((feature*)first)->weight_index - ((feature*)second)->weight_index;}
+{
+  feature_index a = ((feature*)first)->weight_index, b = ((feature*)second)->weight_index;
+  return (a > b) - (a < b);
+}
 
 int order_audit_features(const void* first, const void* second)
 {
-  return (int)(((audit_data*)first)->weight_index) - (int)(((audit_data*)second)->weight_index);
+  size_t a = ((audit_data*)first)->weight_index, b = ((audit_data*)second)->weight_index;
+  return (a > b) - (a < b);
 }
 
 void unique_features(v_array<feature>& features, int max=-1)
@@ -53,11 +57,11 @@ void unique_audit_features(v_array<audit_data>& features, int max = -1)
   features.end = ++last;
 }
 
-void unique_sort_features(bool audit, uint32_t parse_mask, example* ae)
+void unique_sort_features(bool audit, size_t parse_mask, example* ae)
 {
   for (unsigned char* b = ae->indices.begin; b != ae->indices.end; b++)
     {
-      v_array<feature> features = ae->atomics[*b];
+      v_array<feature>& features = ae->atomics[*b];
       
       for (size_t i = 0; i < features.size(); i++)
 	features[i].weight_index &= parse_mask;
@@ -69,7 +73,7 @@ void unique_sort_features(bool audit, uint32_t parse_mask, example* ae)
 	{
 	  v_array<audit_data> afeatures = ae->audit_features[*b];
 
-	  for (size_t i = 0; i < ae->atomics[*b].size(); i++)
+	  for (size_t i = 0; i < features.size(); i++)
 	    afeatures[i].weight_index &= parse_mask;
 	  
 	  qsort(afeatures.begin, afeatures.size(), sizeof(audit_data), 
@@ -7,6 +7,6 @@ license as described in the file LICENSE.
 #include "parser.h"
 #include "example.h"
 
-void unique_sort_features(bool audit, uint32_t parse_mask, example* ae);
+void unique_sort_features(bool audit, size_t parse_mask, example* ae);
 int order_features(const void* first, const void* second);
 void unique_features(v_array<feature>& features, int max = -1);
@@ -17,6 +17,10 @@ license as described in the file LICENSE.
 #endif
 
 const size_t erase_point = ~ ((1 << 10) -1);
+// set in erase_count while begin points into space lent by something else
+// (see namespace_table): growing copies out instead of calling realloc, and
+// neither erase nor delete_v gives the space back
+const size_t borrowed_space = (size_t)1 << (8 * sizeof(size_t) - 1);
 
 template<class T> struct v_array {
  public:
@@ -37,7 +41,16 @@ template<class T> struct v_array {
       if ((size_t)(end_array-begin) != length)
 	{
 	  size_t old_len = end-begin;
-	  begin = (T *)realloc(begin, sizeof(T) * length);
+	  if (erase_count & borrowed_space)
+	    {
+	      T* lent = begin;
+	      begin = (T *)malloc(sizeof(T) * length);
+	      if (begin != nullptr && old_len > 0)
+		memcpy(begin, lent, sizeof(T) * (old_len < length ? old_len : length));
+	      erase_count &= ~borrowed_space;
+	    }
+	  else
+	    begin = (T *)realloc(begin, sizeof(T) * length);
 	  if ((begin == nullptr) && ((sizeof(T)*length) > 0)) {
 	    std::cerr << "realloc of " << length << " failed in resize().  out of memory?" << std::endl;
 	    throw std::exception();
@@ -50,16 +63,18 @@ template<class T> struct v_array {
     }
 
   void erase() 
-  { if (++erase_count & erase_point)
+  { if (!(erase_count & borrowed_space) && (++erase_count & erase_point))
       {
 	resize(end-begin);
 	erase_count = 0;
       }
     end = begin;
   }
+  // erase that never gives the space back, for arrays refilled every example
+  void clear() { end = begin; }
   void delete_v()
   {
-    if (begin != nullptr)
+    if (begin != nullptr && !(erase_count & borrowed_space))
       free(begin);
     begin = end = end_array = nullptr;
   }
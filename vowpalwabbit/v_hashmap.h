@@ -201,6 +201,30 @@ template<class K, class V> class v_hashmap{
     }
   }
 
+  // like get(), but leaves last_position alone so that several parser
+  // threads can look up the same (read-only) map concurrently.
+  V& find(K key, size_t hash) {
+    size_t sz  = base_size();
+    size_t first_position = hash % sz;
+    size_t position = first_position;
+    while (true) {
+      if (!dat[position].occupied)
+        return default_value;
+
+      if ((dat[position].hash == hash) && is_equivalent(key, dat[position].key))
+        return dat[position].val;
+
+      position++;
+      if (position >= sz)
+        position = 0;
+
+      if (position == first_position) {
+        std::cerr << "error: v_hashmap did not grow enough!" << std::endl;
+        throw std::exception();
+      }
+    }
+  }
+
   bool contains(K& key, size_t hash) {
     size_t sz  = base_size();
     size_t first_position = hash % sz;
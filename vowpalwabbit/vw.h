@@ -9,6 +9,7 @@ license as described in the file LICENSE.
 #include "hash.h"
 #include "simple_label.h"
 #include "parser.h"
+#include "sparse_weights.h"
 
 namespace VW {
 
@@ -89,27 +90,33 @@ namespace VW {
     return (uint32_t)all.p->hasher(ss,hash_base);
   }
   //Then use it as the seed for hashing features.
-  inline uint32_t hash_feature(vw& all, string s, unsigned long u)
+  inline feature_index hash_feature(vw& all, string s, unsigned long u)
   {
     substring ss;
     ss.begin = (char*)s.c_str();
     ss.end = ss.begin + s.length();
-    return (uint32_t)(all.p->hasher(ss,u) & all.parse_mask);
+    return (feature_index)(all.p->hasher(ss,u) & all.parse_mask);
   }
 
-  inline uint32_t hash_feature_cstr(vw& all, char* fstr, unsigned long u)
+  inline feature_index hash_feature_cstr(vw& all, char* fstr, unsigned long u)
   {
     substring ss;
     ss.begin = fstr;
     ss.end = ss.begin + strlen(fstr);
-    return (uint32_t)(all.p->hasher(ss,u) & all.parse_mask);
+    return (feature_index)(all.p->hasher(ss,u) & all.parse_mask);
   }
 
-  inline float get_weight(vw& all, uint32_t index, uint32_t offset)
-  { return all.reg.weight_vector[(((index << all.reg.stride_shift) + offset) & all.reg.weight_mask)];}
+  inline float get_weight(vw& all, feature_index index, uint32_t offset)
+  { return read_weight(all.reg, (((index << all.reg.stride_shift) + offset) & all.reg.weight_mask));}
 
-  inline void set_weight(vw& all, uint32_t index, uint32_t offset, float value)
-  { all.reg.weight_vector[(((index << all.reg.stride_shift) + offset) & all.reg.weight_mask)] = value;}
+  inline void set_weight(vw& all, feature_index index, uint32_t offset, float value)
+  {
+    size_t i = ((index << all.reg.stride_shift) + offset) & all.reg.weight_mask;
+    if (all.reg.sparse != nullptr)
+      sparse_weight(*all.reg.sparse, i, true) = value;
+    else
+      all.reg.weight_vector[i] = value;
+  }
 
   inline uint32_t num_weights(vw& all)
   { return (uint32_t)all.length();}